@@ -0,0 +1,344 @@
+#include "tetris_batch.hpp"
+#include "tetris_bot.hpp"
+#include "tetris_dataset.hpp"
+#include "tetris_session.hpp"
+#include "tetris_versus.hpp"
+#include <getopt.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+
+using namespace tetris;
+
+
+const char OPTSTRING[7] = "n:j:h";
+const option LONGOPTS[13] = {
+  {"games", true, nullptr, 'n'},
+  {"threads", true, nullptr, 'j'},
+  {"seed", true, nullptr, 256},
+  {"max-pieces", true, nullptr, 257},
+  {"disable-gravity", false, nullptr, 258},
+  {"policy", true, nullptr, 259},
+  {"beam-width", true, nullptr, 260},
+  {"depth", true, nullptr, 261},
+  {"export", true, nullptr, 262},
+  {"export-capacity", true, nullptr, 263},
+  {"versus", false, nullptr, 264},
+  {"help", false, nullptr, 'h'},
+  {0, 0, 0, 0},
+};
+
+
+void print_help(const std::string& run_command)
+{
+  std::cout <<
+    "Usage: " + run_command + " [OPTS]..." "\n"
+    "\n"
+    "Play a batch of simulated games in parallel and report their statistics." "\n"
+    "\n"
+    "-n, --games N          Number of games to play (default 1000)." "\n"
+    "-j, --threads N        Number of worker threads (default one per hardware thread)." "\n"
+    "    --seed SEED        Seed for the batch; each game derives its own seed from it." "\n"
+    "    --max-pieces N     End each game after N pieces lock (default 10000, 0 for no limit)." "\n"
+    "    --disable-gravity  Play without gravity." "\n"
+    "    --policy POLICY    Player for every game: 'random' (default) or 'bot'." "\n"
+    "    --beam-width N     Beam width of the bot policy (default 16)." "\n"
+    "    --depth N          Tetriminoes searched ahead by the bot policy, including the" "\n"
+    "                       active one (default 3)." "\n"
+    "    --export FILE      Write a training record for every locked piece to FILE: the" "\n"
+    "                       board, active, held and preview pieces, placement and score." "\n"
+    "    --export-capacity N" "\n"
+    "                       Most records to export (default games x max pieces)." "\n"
+    "    --versus           Play two-board matches instead of single games: line clears" "\n"
+    "                       send garbage to the other board, and each board runs on its" "\n"
+    "                       own thread. --games sets the number of matches." "\n"
+    "-h, --help             Display this message."
+            << std::endl;
+}
+
+void print_distribution(const char* name, const batch::Distribution& distribution)
+{
+  std::printf("%-8s %12.0f %12.1f %12.0f %12.0f %12.0f %12.0f\n",
+              name,
+              distribution.min,
+              distribution.mean,
+              distribution.p50,
+              distribution.p90,
+              distribution.p99,
+              distribution.max);
+}
+
+/* Play a batch of versus matches and report their statistics. */
+void run_versus(const batch::BatchSettings& settings, const batch::PolicyFactory& make_policy)
+{
+  versus::VersusSettings versus_settings;
+  versus_settings.match_settings.game_settings = settings.game_settings;
+  versus_settings.match_settings.max_tetriminoes = settings.max_tetriminoes;
+  versus_settings.matches = settings.games;
+  versus_settings.threads = settings.threads;
+  versus_settings.seed = settings.seed;
+
+  versus::VersusResult result = versus::run_matches(versus_settings, make_policy);
+
+  // Per-board statistics go into one list, with each match's throughput alongside
+  std::vector<batch::GameStats> boards;
+  std::vector<double> frame_rates;
+  std::vector<double> tetrimino_rates;
+  std::array<long, 2> wins{0, 0};
+  long draws = 0;
+  long total_frames = 0;
+  long garbage_sent = 0;
+  double seconds = 0;
+  double wait_seconds = 0;
+  batch::SearchCounters search;
+  for (const versus::MatchStats& match : result.matches)
+  {
+    if (match.winner < 0)
+      ++draws;
+    else
+      ++wins[match.winner];
+
+    long match_frames = 0;
+    long match_tetriminoes = 0;
+    for (const versus::BoardStats& board : match.boards)
+    {
+      boards.push_back(batch::GameStats{board.score, 0, board.rows, board.tetriminoes, board.frames, board.search});
+      match_frames += board.frames;
+      match_tetriminoes += board.tetriminoes;
+      total_frames += board.frames;
+      garbage_sent += board.garbage_sent;
+      seconds += board.seconds;
+      wait_seconds += board.wait_seconds;
+      search += board.search;
+    }
+
+    // Both boards together
+    frame_rates.push_back(match_frames / match.seconds);
+    tetrimino_rates.push_back(match_tetriminoes / match.seconds);
+  }
+
+  std::printf("Matches: %ld  Threads: %u  Seed: %llu  Time: %.3f s  (%.1f matches/s, %.0f frames/s)\n",
+              (long)result.matches.size(),
+              result.threads,
+              (unsigned long long)settings.seed,
+              result.seconds,
+              result.matches.size() / result.seconds,
+              total_frames / result.seconds);
+  std::printf("Wins: %ld first, %ld second, %ld drawn  Garbage: %ld rows sent  Waiting: %.1f%% of board time\n",
+              wins[0],
+              wins[1],
+              draws,
+              garbage_sent,
+              seconds > 0 ? 100 * wait_seconds / seconds : 0);
+  std::printf("%-8s %12s %12s %12s %12s %12s %12s\n", "", "min", "mean", "p50", "p90", "p99", "max");
+  print_distribution("Score", batch::summarize(boards, [] (const batch::GameStats& g) { return g.score; }));
+  print_distribution("Rows", batch::summarize(boards, [] (const batch::GameStats& g) { return g.rows; }));
+  print_distribution("Pieces", batch::summarize(boards, [] (const batch::GameStats& g) { return g.tetriminoes; }));
+  print_distribution("Frames", batch::summarize(boards, [] (const batch::GameStats& g) { return g.frames; }));
+  print_distribution("Frames/s", batch::summarize(frame_rates));
+  print_distribution("Pieces/s", batch::summarize(tetrimino_rates));
+
+  if (search.searches > 0)
+  {
+    std::printf("Search: %ld nodes, %.0f nodes/s per thread, average depth %.2f\n",
+                search.nodes,
+                search.nodes / search.seconds,
+                (double)search.depth_total / search.searches);
+  }
+}
+
+
+int main(int const argc, char* const argv[])
+{
+  // Set option defaults
+  batch::BatchSettings settings;
+  settings.game_settings.gravity = true;
+  settings.game_settings.preview_size = 6;
+  settings.game_settings.seed = 0;
+  settings.games = 1000;
+  settings.threads = 0;
+  settings.seed = std::random_device()();
+  settings.max_tetriminoes = 10000;
+
+  std::string policy = "random";
+  std::string export_path;
+  long export_capacity = 0;
+  bool versus = false;
+  bot::BotSettings bot_settings;
+  bot_settings.beam_width = 16;
+  bot_settings.max_depth = 3;
+  bot_settings.threads = 1; // Games already run in parallel
+  bot_settings.max_think_time = std::chrono::duration<float>(0);
+
+  // Process command line options
+  int opt;
+  while ((opt = getopt_long(argc, argv, OPTSTRING, LONGOPTS, nullptr)) != -1)
+  {
+    switch(opt)
+    {
+      case 'n': // --games
+        settings.games = atol(optarg);
+        break;
+
+      case 'j': // --threads
+        settings.threads = atoi(optarg);
+        break;
+
+      case 256: // --seed
+        settings.seed = strtoull(optarg, nullptr, 0);
+        break;
+
+      case 257: // --max-pieces
+        settings.max_tetriminoes = atol(optarg);
+        break;
+
+      case 258: // --disable-gravity
+        settings.game_settings.gravity = false;
+        break;
+
+      case 259: // --policy
+        policy = optarg;
+        break;
+
+      case 260: // --beam-width
+        bot_settings.beam_width = atoi(optarg);
+        break;
+
+      case 261: // --depth
+        bot_settings.max_depth = atoi(optarg);
+        break;
+
+      case 262: // --export
+        export_path = optarg;
+        break;
+
+      case 263: // --export-capacity
+        export_capacity = atol(optarg);
+        break;
+
+      case 264: // --versus
+        versus = true;
+        break;
+
+      case 'h': // --help
+        print_help(argv[0]);
+        exit(0);
+        break;
+
+      default:
+        print_help(argv[0]);
+        std::cerr << "Aborting." << std::endl;
+        exit(-1);
+        break;
+    }
+  }
+
+  batch::PolicyFactory make_policy;
+  if (policy == "random")
+  {
+    make_policy = [] (std::uint64_t seed) { return std::make_unique<batch::RandomPolicy>(seed); };
+  }
+  else if (policy == "bot")
+  {
+    make_policy = [&bot_settings] (std::uint64_t) { return std::make_unique<bot::Bot>(bot_settings); };
+  }
+  else
+  {
+    std::cerr << "Error: " << "Unknown policy '" << policy << "'." << std::endl;
+    std::cerr << "Aborting." << std::endl;
+    exit(-1);
+  }
+
+  if (versus)
+  {
+    if (!export_path.empty())
+    {
+      std::cerr << "Error: " << "--export cannot be used with --versus." << std::endl;
+      std::cerr << "Aborting." << std::endl;
+      exit(-1);
+    }
+
+    run_versus(settings, make_policy);
+    return 0;
+  }
+
+  // Open dataset file
+  std::unique_ptr<dataset::Exporter> exporter;
+  if (!export_path.empty())
+  {
+    if (export_capacity == 0)
+      export_capacity = settings.games * settings.max_tetriminoes;
+    if (export_capacity <= 0)
+    {
+      std::cerr << "Error: " << "--export-capacity is needed when games have no piece limit." << std::endl;
+      std::cerr << "Aborting." << std::endl;
+      exit(-1);
+    }
+
+    exporter = std::make_unique<dataset::Exporter>();
+    if (!exporter->open(export_path, export_capacity))
+    {
+      std::cerr << "Error: " << exporter->error << std::endl;
+      std::cerr << "Aborting." << std::endl;
+      exit(-1);
+    }
+    settings.exporter = exporter.get();
+  }
+
+  // Play games
+  batch::BatchResult result = batch::run_batch(settings, make_policy);
+
+  if (exporter && !exporter->finish())
+  {
+    std::cerr << "Error: " << exporter->error << std::endl;
+    exit(-1);
+  }
+
+  // Report statistics
+  long total_frames = 0;
+  for (const batch::GameStats& game : result.games)
+    total_frames += game.frames;
+
+  std::printf("Games: %ld  Threads: %u  Seed: %llu  Time: %.3f s  (%.1f games/s, %.0f frames/s)\n",
+              (long)result.games.size(),
+              result.threads,
+              (unsigned long long)settings.seed,
+              result.seconds,
+              result.games.size() / result.seconds,
+              total_frames / result.seconds);
+  std::printf("%-8s %12s %12s %12s %12s %12s %12s\n", "", "min", "mean", "p50", "p90", "p99", "max");
+  print_distribution("Score", batch::summarize(result.games, [] (const batch::GameStats& g) { return g.score; }));
+  print_distribution("Level", batch::summarize(result.games, [] (const batch::GameStats& g) { return g.level; }));
+  print_distribution("Rows", batch::summarize(result.games, [] (const batch::GameStats& g) { return g.rows; }));
+  print_distribution("Pieces", batch::summarize(result.games, [] (const batch::GameStats& g) { return g.tetriminoes; }));
+
+  batch::SearchCounters search;
+  for (const batch::GameStats& game : result.games)
+    search += game.search;
+  if (search.searches > 0)
+  {
+    std::printf("Search: %ld nodes, %.0f nodes/s per thread, average depth %.2f\n",
+                search.nodes,
+                search.nodes / search.seconds,
+                (double)search.depth_total / search.searches);
+  }
+
+  if (exporter)
+  {
+    std::printf("Export: %llu records to %s (%.0f records/s), %ld dropped over capacity\n",
+                (unsigned long long)exporter->record_count,
+                export_path.c_str(),
+                exporter->record_count / result.seconds,
+                exporter->dropped.load());
+  }
+
+  return 0;
+}
@@ -0,0 +1,539 @@
+#include "tetris_batch.hpp"
+#include "tetris_collision.hpp"
+#include "tetris_game.hpp"
+#include "tetris_movegen.hpp"
+#include "tetris_session.hpp"
+#include <getopt.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+using namespace tetris;
+
+
+const char OPTSTRING[9] = "o:b:t:h";
+const option LONGOPTS[7] = {
+  {"output", true, nullptr, 'o'},
+  {"baseline", true, nullptr, 'b'},
+  {"threshold", true, nullptr, 't'},
+  {"min-time", true, nullptr, 256},
+  {"filter", true, nullptr, 257},
+  {"help", false, nullptr, 'h'},
+  {0, 0, 0, 0},
+};
+
+/* Seed of the game corpus. The corpus is drawn with game::Random alone, so it is the same
+ * with any standard library; changing the seed, or how the random policy plays,
+ * invalidates every saved baseline */
+const std::uint64_t CORPUS_SEED = 0x7E7215;
+
+/* Number of board states sampled into the corpus */
+const long CORPUS_SIZE = 1024;
+
+/* Number of timed samples per benchmark; the fastest is reported */
+const short SAMPLES = 5;
+
+/* Version of the JSON results format */
+const short RESULTS_VERSION = 1;
+
+
+/* Result of one benchmark */
+struct BenchmarkResult
+{
+  std::string name;
+  double ns_per_op;
+  long ops;
+};
+
+/* A tetrimino positioned on one of the corpus boards */
+struct Position
+{
+  long board;
+  game::Tetrimino tetrimino;
+};
+
+/* Board states sampled from seeded games, so every run measures the same work */
+struct Corpus
+{
+  std::vector<game::Playfield> boards;
+  std::vector<Position> positions;
+
+  // Positions that rotate without a kick, and positions that need one, per direction
+  std::array<std::vector<Position>, 2> plain_rotations;
+  std::array<std::vector<Position>, 2> kicked_rotations;
+
+  // Boards with 0 to 4 full rows
+  std::array<std::vector<game::Playfield>, 5> clear_boards;
+};
+
+
+/* Written by every benchmark so that the work cannot be optimized away */
+volatile long sink;
+
+
+void print_help(const std::string& run_command)
+{
+  std::cout <<
+    "Usage: " + run_command + " [OPTS]..." "\n"
+    "\n"
+    "Time core game operations on a fixed, seeded corpus of boards, and simulated games." "\n"
+    "\n"
+    "-o, --output FILE       Write results to FILE as JSON." "\n"
+    "-b, --baseline FILE     Compare results with those saved in FILE by --output, and exit" "\n"
+    "                        with status 1 if any benchmark has slowed beyond the threshold." "\n"
+    "-t, --threshold PCT     Slowdown that counts as a regression, in percent (default 10)." "\n"
+    "    --min-time SECONDS  Time spent on each benchmark (default 0.5)." "\n"
+    "    --filter TEXT       Only run benchmarks whose names contain TEXT." "\n"
+    "-h, --help              Display this message."
+            << std::endl;
+}
+
+/* Check whether a rotation of a tetrimino needs a kick, i.e. its unkicked candidate collides */
+bool needs_kick(const game::Tetrimino& tetrimino,
+                game::RotationDirection direction,
+                const game::Playfield& playfield)
+{
+  short turns = direction == game::RotationDirection::CW ? 1 : 3;
+  short new_facing = ((short)tetrimino.facing + turns) % 4;
+  const game::RotationCandidate& plain
+    = game::ROTATION_TABLE[(short)tetrimino.type][(short)tetrimino.facing][new_facing][0];
+
+  std::array<game::Point, 4> points;
+  for (short i=0; i<4; i++)
+    points[i] = tetrimino.pivot + plain.mino_offsets[i];
+  return game::check_collision(points, playfield) != game::CollisionResult::NONE;
+}
+
+Corpus build_corpus()
+{
+  Corpus corpus;
+  game::Random random(CORPUS_SEED);
+  session::GameSettings settings{true, 6, 0};
+
+  // Sample states from games mixing sensible drops with random moves
+  for (long game_index=0; (long)corpus.boards.size() < CORPUS_SIZE; game_index++)
+  {
+    std::uint64_t seed = batch::game_seed(CORPUS_SEED, game_index);
+    settings.seed = seed;
+    session::Session session(settings);
+    batch::RandomPolicy policy(seed);
+
+    while (!session.is_over() && (long)corpus.boards.size() < CORPUS_SIZE)
+    {
+      session::Command command = policy.next_command(session);
+      if (random.below(4) == 0)
+        command = (session::Command)((short)session::Command::SHIFT_LEFT + random.below(6));
+      session.step(command);
+
+      if (random.below(8) == 0)
+      {
+        corpus.positions.push_back(Position{(long)corpus.boards.size(), session.game.active_tetrimino});
+        corpus.boards.push_back(session.game.playfield);
+      }
+    }
+  }
+
+  // Sort positions by how they rotate, blocking the unkicked rotation where needed so
+  // that every position also has a kicked counterpart
+  for (short d=0; d<2; d++)
+  {
+    game::RotationDirection direction = d == 0 ? game::RotationDirection::CW : game::RotationDirection::CCW;
+    for (const Position& position : corpus.positions)
+    {
+      const game::Tetrimino& tetrimino = position.tetrimino;
+      if (tetrimino.type == game::TetriminoType::O)
+        continue;
+
+      game::Playfield board = corpus.boards[position.board];
+      if (!needs_kick(tetrimino, direction, board))
+      {
+        corpus.plain_rotations[d].push_back(position);
+
+        // Fill one cell of the unkicked rotation that the tetrimino does not occupy
+        short turns = d == 0 ? 1 : 3;
+        short new_facing = ((short)tetrimino.facing + turns) % 4;
+        const game::RotationCandidate& plain
+          = game::ROTATION_TABLE[(short)tetrimino.type][(short)tetrimino.facing][new_facing][0];
+        for (const game::Point& offset : plain.mino_offsets)
+        {
+          game::Point p = tetrimino.pivot + offset;
+          bool occupied = std::any_of(tetrimino.points.begin(), tetrimino.points.end(),
+                                      [&p] (const game::Point& q) { return q.row == p.row && q.col == p.col; });
+          if (p.row >= 0 && !occupied)
+          {
+            board.set(p, game::TetriminoType::Z);
+            break;
+          }
+        }
+      }
+
+      game::Tetrimino rotated = tetrimino;
+      if (needs_kick(tetrimino, direction, board) && rotated.rotate(direction, board))
+      {
+        corpus.boards.push_back(board);
+        corpus.kicked_rotations[d].push_back(Position{(long)corpus.boards.size() - 1, tetrimino});
+      }
+    }
+  }
+
+  // Fill distinct rows in the lower half of each board for the row clearing benchmarks
+  for (short full_rows=0; full_rows<=4; full_rows++)
+  {
+    for (long i=0; i<CORPUS_SIZE; i++)
+    {
+      game::Playfield board = corpus.boards[i];
+      std::array<short, 20> candidates;
+      for (short j=0; j<20; j++)
+        candidates[j] = 20 + j;
+      for (short j=0; j<full_rows; j++)
+      {
+        std::swap(candidates[j], candidates[j + random.below(20 - j)]);
+        for (short col=0; col<game::Playfield::WIDTH; col++)
+          board.set(game::Point(candidates[j], col), game::TetriminoType::I);
+      }
+      corpus.clear_boards[full_rows].push_back(board);
+    }
+  }
+
+  return corpus;
+}
+
+/* Time an operation that performs ops_per_call operations each time it is called.
+ *
+ * The operation is called repeatedly for min_time in total, over SAMPLES samples, and the
+ * fastest sample is reported.
+ */
+template <typename Operation>
+BenchmarkResult measure(const std::string& name, long ops_per_call, double min_time, Operation operation)
+{
+  BenchmarkResult result{name, 0, 0};
+  std::chrono::duration<double> sample_time(min_time / SAMPLES);
+  for (short sample=0; sample<SAMPLES; sample++)
+  {
+    long ops = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed(0);
+    do
+    {
+      operation();
+      ops += ops_per_call;
+      elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed < sample_time);
+
+    double ns_per_op = elapsed.count() * 1e9 / ops;
+    if (sample == 0 || ns_per_op < result.ns_per_op)
+      result.ns_per_op = ns_per_op;
+    result.ops += ops;
+  }
+  return result;
+}
+
+std::vector<BenchmarkResult> run_benchmarks(const Corpus& corpus, double min_time, const std::string& filter)
+{
+  std::vector<BenchmarkResult> results;
+  auto run = [&] (const std::string& name, long ops_per_call, auto operation)
+  {
+    if (name.find(filter) == std::string::npos)
+      return;
+    results.push_back(measure(name, ops_per_call, min_time, operation));
+    std::printf("%-24s %12.2f ns/op\n", name.c_str(), results.back().ns_per_op);
+    std::fflush(stdout);
+  };
+
+  const std::vector<Position>& positions = corpus.positions;
+
+  run("check_collision_point", 4 * positions.size(), [&] ()
+  {
+    long total = 0;
+    for (const Position& position : positions)
+      for (const game::Point& p : position.tetrimino.points)
+        total += game::check_collision(p, corpus.boards[position.board]);
+    sink = total;
+  });
+
+  run("check_collision_array", positions.size(), [&] ()
+  {
+    long total = 0;
+    for (const Position& position : positions)
+      total += game::check_collision(position.tetrimino.points, corpus.boards[position.board]);
+    sink = total;
+  });
+
+  run("translate", 2 * positions.size(), [&] ()
+  {
+    long total = 0;
+    for (const Position& position : positions)
+    {
+      game::Tetrimino tetrimino = position.tetrimino;
+      total += tetrimino.translate(game::Point(0, -1), corpus.boards[position.board]);
+      total += tetrimino.translate(game::Point(1, 1), corpus.boards[position.board]);
+    }
+    sink = total;
+  });
+
+  const std::array<const char*, 2> rotation_names{"rotate_cw", "rotate_ccw"};
+  for (short d=0; d<2; d++)
+  {
+    game::RotationDirection direction = d == 0 ? game::RotationDirection::CW : game::RotationDirection::CCW;
+    for (short kicked=0; kicked<2; kicked++)
+    {
+      const std::vector<Position>& rotations
+        = kicked ? corpus.kicked_rotations[d] : corpus.plain_rotations[d];
+      std::string name = std::string(rotation_names[d]) + (kicked ? "_kick" : "");
+      run(name, rotations.size(), [&] ()
+      {
+        long total = 0;
+        for (const Position& position : rotations)
+        {
+          game::Tetrimino tetrimino = position.tetrimino;
+          if (direction == game::RotationDirection::CW)
+            total += tetrimino.rotate_cw(corpus.boards[position.board]);
+          else
+            total += tetrimino.rotate_ccw(corpus.boards[position.board]);
+        }
+        sink = total;
+      });
+    }
+  }
+
+  run("get_landing", positions.size(), [&] ()
+  {
+    long total = 0;
+    for (const Position& position : positions)
+      total += position.tetrimino.get_landing(corpus.boards[position.board]).pivot.row;
+    sink = total;
+  });
+
+  // Collision maps of every tetrimino type on each board, as built by each move search
+  collision::CollisionMap map;
+  auto build_maps = [&] (auto build_map)
+  {
+    long total = 0;
+    for (const game::Playfield& board : corpus.boards)
+    {
+      for (short type=1; type<8; type++)
+      {
+        build_map((game::TetriminoType)type, board, map);
+        total += map.columns[0][0];
+      }
+    }
+    sink = total;
+  };
+
+  run("collision_map_scalar", 7 * corpus.boards.size(), [&] ()
+  {
+    build_maps(collision::build_map_scalar);
+  });
+
+  if (collision::active_kernel() == collision::Kernel::AVX2)
+  {
+    run("collision_map_avx2", 7 * corpus.boards.size(), [&] ()
+    {
+      build_maps(collision::build_map_avx2);
+    });
+  }
+
+  std::unique_ptr<movegen::MoveGenerator> generator = std::make_unique<movegen::MoveGenerator>();
+  run("movegen_generate", positions.size(), [&] ()
+  {
+    long total = 0;
+    for (const Position& position : positions)
+      total += generator->generate(game::Tetrimino(position.tetrimino.type), corpus.boards[position.board]);
+    sink = total;
+  });
+
+  for (short full_rows=0; full_rows<=4; full_rows++)
+  {
+    const std::vector<game::Playfield>& boards = corpus.clear_boards[full_rows];
+    game::Game game(CORPUS_SEED);
+    run("clear_rows_" + std::to_string(full_rows), boards.size(), [&] ()
+    {
+      for (const game::Playfield& board : boards)
+      {
+        game.playfield = board;
+        game.clear_rows();
+      }
+      sink = game.score;
+    });
+  }
+
+  run("bag_pop", CORPUS_SIZE, [&] ()
+  {
+    game::Bag bag(CORPUS_SEED);
+    long total = 0;
+    for (long i=0; i<CORPUS_SIZE; i++)
+      total += (short)bag.pop().type;
+    sink = total;
+  });
+
+  // Whole games with the random policy, as played by tetris-batch
+  const long games = 64;
+  run("game_random", games, [&] ()
+  {
+    session::GameSettings settings{true, 6, 0};
+    long total = 0;
+    for (long i=0; i<games; i++)
+    {
+      std::uint64_t seed = batch::game_seed(CORPUS_SEED, i);
+      batch::RandomPolicy policy(seed);
+      total += batch::play_game(settings, seed, policy, 0).frames;
+    }
+    sink = total;
+  });
+
+  return results;
+}
+
+bool write_results(const std::string& path, const std::vector<BenchmarkResult>& results)
+{
+  std::FILE* file = std::fopen(path.c_str(), "w");
+  if (!file)
+    return false;
+
+  // One benchmark per line, which read_baseline() relies on
+  std::fprintf(file, "{\n");
+  std::fprintf(file, "  \"version\": %hd,\n", RESULTS_VERSION);
+  std::fprintf(file, "  \"corpus_seed\": %llu,\n", (unsigned long long)CORPUS_SEED);
+  std::fprintf(file, "  \"benchmarks\": [\n");
+  for (size_t i=0; i<results.size(); i++)
+  {
+    std::fprintf(file, "    {\"name\": \"%s\", \"ns_per_op\": %.4f, \"ops\": %ld}%s\n",
+                 results[i].name.c_str(),
+                 results[i].ns_per_op,
+                 results[i].ops,
+                 i + 1 < results.size() ? "," : "");
+  }
+  std::fprintf(file, "  ]\n");
+  std::fprintf(file, "}\n");
+  return std::fclose(file) == 0;
+}
+
+bool read_baseline(const std::string& path, std::map<std::string, double>& baseline)
+{
+  std::ifstream file(path);
+  if (!file)
+    return false;
+
+  std::string line;
+  while (std::getline(file, line))
+  {
+    char name[64];
+    double ns_per_op;
+    if (std::sscanf(line.c_str(), " {\"name\": \"%63[^\"]\", \"ns_per_op\": %lf", name, &ns_per_op) == 2)
+      baseline[name] = ns_per_op;
+  }
+  return true;
+}
+
+
+int main(int const argc, char* const argv[])
+{
+  // Set option defaults
+  std::string output_path;
+  std::string baseline_path;
+  double threshold = 10;
+  double min_time = 0.5;
+  std::string filter;
+
+  // Process command line options
+  int opt;
+  while ((opt = getopt_long(argc, argv, OPTSTRING, LONGOPTS, nullptr)) != -1)
+  {
+    switch(opt)
+    {
+      case 'o': // --output
+        output_path = optarg;
+        break;
+
+      case 'b': // --baseline
+        baseline_path = optarg;
+        break;
+
+      case 't': // --threshold
+        threshold = atof(optarg);
+        break;
+
+      case 256: // --min-time
+        min_time = atof(optarg);
+        break;
+
+      case 257: // --filter
+        filter = optarg;
+        break;
+
+      case 'h': // --help
+        print_help(argv[0]);
+        exit(0);
+        break;
+
+      default:
+        print_help(argv[0]);
+        std::cerr << "Aborting." << std::endl;
+        exit(-1);
+        break;
+    }
+  }
+
+  Corpus corpus = build_corpus();
+  std::printf("Corpus: %ld boards, %ld positions, %ld/%ld plain/kicked rotations, seed %llu\n",
+              (long)corpus.boards.size(),
+              (long)corpus.positions.size(),
+              (long)(corpus.plain_rotations[0].size() + corpus.plain_rotations[1].size()),
+              (long)(corpus.kicked_rotations[0].size() + corpus.kicked_rotations[1].size()),
+              (unsigned long long)CORPUS_SEED);
+
+  std::vector<BenchmarkResult> results = run_benchmarks(corpus, min_time, filter);
+
+  if (!output_path.empty() && !write_results(output_path, results))
+  {
+    std::cerr << "Error: " << "Could not write " << output_path << std::endl;
+    exit(-1);
+  }
+
+  // Compare with baseline
+  if (baseline_path.empty())
+    return 0;
+
+  std::map<std::string, double> baseline;
+  if (!read_baseline(baseline_path, baseline))
+  {
+    std::cerr << "Error: " << "Could not read " << baseline_path << std::endl;
+    exit(-1);
+  }
+
+  long regressions = 0;
+  std::printf("\n%-24s %12s %12s %9s\n", "", "baseline", "current", "change");
+  for (const BenchmarkResult& result : results)
+  {
+    auto saved = baseline.find(result.name);
+    if (saved == baseline.end())
+      continue;
+
+    double change = (result.ns_per_op - saved->second) / saved->second * 100;
+    bool regressed = change > threshold;
+    regressions += regressed;
+    std::printf("%-24s %12.2f %12.2f %+8.1f%%%s\n",
+                result.name.c_str(),
+                saved->second,
+                result.ns_per_op,
+                change,
+                regressed ? "  REGRESSION" : "");
+  }
+
+  if (regressions)
+  {
+    std::printf("%ld benchmark(s) slower than baseline by more than %.1f%%\n", regressions, threshold);
+    return 1;
+  }
+  return 0;
+}
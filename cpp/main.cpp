@@ -1,34 +1,70 @@
+#include "tetris_bot.hpp"
 #include "tetris_cli.hpp"
 #include "tetris_control.hpp"
 #include "tetris_game.hpp"
 #include "tetris_log.hpp"
+#include "tetris_profile.hpp"
+#include "tetris_replay.hpp"
+#include "tetris_save.hpp"
+#include "tetris_session.hpp"
+#include "tetris_timing.hpp"
 #include "tetris_ui.hpp"
 #include <getopt.h>
 #include <locale.h>
 #include <ncurses.h>
+#include <signal.h>
+#include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <random>
 #include <string>
 
 
 using namespace tetris;
 
 
-std::ofstream log::out;
+std::uint64_t random_seed()
+{
+  std::random_device rd;
+  return ((std::uint64_t)rd() << 32) | rd();
+}
 
+int play_replay(const std::string& path)
+{
+  replay::Replay recorded;
+  if (!replay::read_file(path, recorded))
+  {
+    std::cerr << "Error: " << "Could not read replay file '" << path << "'." << std::endl;
+    return -1;
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  session::Session session(recorded.settings);
+  replay::play(recorded, session);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << "Seed:   " << recorded.settings.seed << std::endl;
+  std::cout << "Frames: " << session.frame
+            << " (" << session.frame / elapsed.count() << " frames/s)" << std::endl;
+  std::cout << "Rows:   " << session.game.total_rows_cleared << std::endl;
+  std::cout << "Level:  " << session.game.level << std::endl;
+  std::cout << "Score:  " << session.game.score << std::endl;
+  return 0;
+}
 
 int main(int const argc, char* const argv[])
 {
-  // Open log file
-  log::out.open("tetris.log");
-
   // Set option defaults
-  control::GameSettings settings;
+  session::GameSettings settings;
   settings.gravity = true;
   settings.preview_size = 6;
+  settings.seed = 0;
 
   // Process command line options
-  cli::opterror cli_errors = cli::process_options(argc, argv, settings);
+  cli::RunOptions run_options;
+  cli::opterror cli_errors = cli::process_options(argc, argv, settings, run_options);
   if (cli_errors)
   {
     cli::HelpFormatter help(argv[0]);
@@ -43,29 +79,131 @@ int main(int const argc, char* const argv[])
     exit(-1);
   }
 
-  log::out << "settings.gravity=" << settings.gravity << std::endl;
-  log::out << "settings.preview_size=" << settings.preview_size << std::endl;
+  // Play back a replay without starting the UI
+  if (!run_options.replay_path.empty())
+    return play_replay(run_options.replay_path);
+
+  // Load the game to resume before the autosave can overwrite it
+  save::SaveState resume_state;
+  bool resuming = !run_options.resume_path.empty();
+  if (resuming)
+  {
+    if (!save::read_file(run_options.resume_path, resume_state))
+    {
+      std::cerr << "Error: " << "No saved game in '" << run_options.resume_path << "'." << std::endl;
+      std::cerr << "Aborting." << std::endl;
+      exit(-1);
+    }
+    if (resume_state.over)
+    {
+      std::cerr << "Error: " << "The game saved in '" << run_options.resume_path
+                << "' is already over." << std::endl;
+      std::cerr << "Aborting." << std::endl;
+      exit(-1);
+    }
+    settings = save::saved_settings(resume_state);
+  }
+
+  // Open log file
+  if (!run_options.log_path.empty() && !log::open(run_options.log_path))
+    std::cerr << "Could not open log file " << run_options.log_path << std::endl;
+
+  TETRIS_LOG_INFO("settings.gravity=" << settings.gravity);
+  TETRIS_LOG_INFO("settings.preview_size=" << settings.preview_size);
+
+  // Set up bot
+  std::unique_ptr<bot::Bot> player_bot;
+  if (run_options.bot)
+  {
+    bot::BotSettings bot_settings;
+    bot_settings.beam_width = 32;
+    bot_settings.max_depth = settings.preview_size + 1;
+    // On simulated time the bot may think as long as it likes, and searches on one
+    // thread so its choices never depend on how the threads were scheduled
+    bot_settings.threads = run_options.virtual_clock ? 1 : 0;
+    bot_settings.max_think_time = run_options.virtual_clock
+      ? std::chrono::duration<float>::zero()
+      : session::TICK_DURATION;
+    player_bot = std::make_unique<bot::Bot>(bot_settings);
+  }
+
+  // Set up time source; null follows real time
+  std::unique_ptr<timing::Clock> clock;
+  if (run_options.virtual_clock)
+    clock = std::make_unique<timing::VirtualClock>();
+
+  // Set up profiler; SIGUSR1 writes a report without stopping the game
+  std::unique_ptr<profile::Profiler> profiler;
+  if (!run_options.profile_path.empty())
+  {
+    profiler = std::make_unique<profile::Profiler>(run_options.profile_path);
+    profile::dump_on_signal(SIGUSR1);
+  }
+
+  // Open autosave file
+  std::unique_ptr<save::Autosave> autosave;
+  if (!run_options.autosave_path.empty())
+  {
+    autosave = std::make_unique<save::Autosave>();
+    if (!autosave->open(run_options.autosave_path, resuming))
+    {
+      std::cerr << autosave->error << std::endl;
+      autosave.reset();
+    }
+  }
 
   // Initialize UI
   ui::init_ui(settings.preview_size);
 
   // Set up and play game repeatedly until game-over or user quits
-  control::GameResult result;
+  session::GameResult result;
+  long recorded_games = 0;
   bool play = true;
   while (play)
   {
-    result = control::play_game(settings);
+    if (!run_options.seed_fixed && !resuming)
+      settings.seed = random_seed();
+    TETRIS_LOG_INFO("settings.seed=" << settings.seed);
+
+    if (resuming)
+    {
+      result = control::play_game(settings, nullptr, player_bot.get(), profiler.get(),
+                                  autosave.get(), &resume_state, clock.get(),
+                                  run_options.repeat_settings);
+      resuming = false;
+    }
+    else if (run_options.record_path.empty())
+    {
+      result = control::play_game(settings, nullptr, player_bot.get(), profiler.get(),
+                                  autosave.get(), nullptr, clock.get(),
+                                  run_options.repeat_settings);
+    }
+    else
+    {
+      replay::Recorder recorder(settings);
+      result = control::play_game(settings, &recorder, player_bot.get(), profiler.get(),
+                                  autosave.get(), nullptr, clock.get(),
+                                  run_options.repeat_settings);
+
+      // The first game keeps the path given, and each later one gets a numbered copy of it
+      std::string record_path = run_options.record_path;
+      if (++recorded_games > 1)
+        record_path += "." + std::to_string(recorded_games);
+      if (!replay::write_file(record_path, recorder.replay))
+        TETRIS_LOG_ERROR("Could not write replay file " << record_path);
+    }
+
     switch (result.end_type)
     {
-      case control::EndType::GAME_OVER:
+      case session::EndType::GAME_OVER:
         play = control::handle_game_over();
         break;
 
-      case control::EndType::QUIT:
+      case session::EndType::QUIT:
         play = false;
         break;
 
-      case control::EndType::RESTART:
+      case session::EndType::RESTART:
         play = true;
         break;
     }
@@ -75,5 +213,20 @@ int main(int const argc, char* const argv[])
   endwin();
   std::cout << "Game over!" << std::endl;
   std::cout << "Score: " << result.end_score << std::endl;
+  std::cout << "Pieces per second: " << result.stats.pieces_per_second << std::endl;
+  std::cout << "Actions per minute: " << result.stats.actions_per_minute << std::endl;
+  std::cout << "Lines per piece: " << result.stats.lines_per_piece << std::endl;
+  std::cout << "Finesse faults: " << result.stats.finesse_faults
+            << " (" << result.stats.extra_inputs << " extra inputs)" << std::endl;
+
+  if (profiler && !profiler->dump())
+    std::cerr << "Could not write profile to " << run_options.profile_path << std::endl;
+
+  if (player_bot && player_bot->totals.searches > 0)
+  {
+    const batch::SearchCounters& search = player_bot->totals;
+    std::cout << "Bot: " << search.nodes / search.seconds << " nodes/s, "
+              << "average depth " << (double)search.depth_total / search.searches << std::endl;
+  }
   return 0;
 }
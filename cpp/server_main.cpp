@@ -0,0 +1,178 @@
+#include "tetris_log.hpp"
+#include "tetris_server.hpp"
+#include "tetris_session.hpp"
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+
+using namespace tetris;
+
+
+const char OPTSTRING[9] = "u:p:j:h";
+const option LONGOPTS[10] = {
+  {"unix", true, nullptr, 'u'},
+  {"port", true, nullptr, 'p'},
+  {"threads", true, nullptr, 'j'},
+  {"max-sessions", true, nullptr, 256},
+  {"preview-size", true, nullptr, 257},
+  {"disable-gravity", false, nullptr, 258},
+  {"log-file", true, nullptr, 259},
+  {"help", false, nullptr, 'h'},
+  {0, 0, 0, 0},
+};
+
+
+void print_help(const std::string& run_command)
+{
+  std::cout <<
+    "Usage: " + run_command + " [OPTS]..." "\n"
+    "\n"
+    "Host games for players connecting over a socket, e.g. with 'telnet localhost PORT' or" "\n"
+    "'socat -,raw,echo=0 UNIX-CONNECT:PATH'. Send SIGUSR1 to print session statistics." "\n"
+    "\n"
+    "-u, --unix PATH          Listen on a Unix socket at PATH." "\n"
+    "-p, --port PORT          Listen on TCP port PORT of the loopback address (default 4000)." "\n"
+    "-j, --threads N          Number of event loop threads (default one per hardware thread)." "\n"
+    "    --max-sessions N     Refuse connections beyond N concurrent sessions (default 10000)." "\n"
+    "    --preview-size SIZE  Number of tetriminoes shown in the piece preview (default 6)." "\n"
+    "    --disable-gravity    Play without gravity." "\n"
+    "    --log-file FILE      Log connections to FILE." "\n"
+    "-h, --help               Display this message."
+            << std::endl;
+}
+
+/* Get the resident set size of this process in bytes, or 0 if it cannot be read */
+long resident_memory()
+{
+  long pages = 0;
+  long resident_pages = 0;
+  std::ifstream statm("/proc/self/statm");
+  if (!(statm >> pages >> resident_pages))
+    return 0;
+  return resident_pages * sysconf(_SC_PAGESIZE);
+}
+
+void print_stats(const server::Server& game_server, long base_memory)
+{
+  server::ServerStats stats = game_server.stats();
+  long resident = resident_memory();
+  std::printf("Sessions: %ld (peak %ld, total %ld)  "
+              "Session memory: %ld bytes (%ld average, %ld max)  "
+              "Process memory: %ld KiB (%ld bytes/session over idle)\n",
+              stats.sessions,
+              stats.peak_sessions,
+              stats.total_sessions,
+              stats.memory,
+              stats.sessions ? stats.memory / stats.sessions : 0,
+              stats.max_session_memory,
+              resident / 1024,
+              stats.sessions ? (resident - base_memory) / stats.sessions : 0);
+  std::fflush(stdout);
+}
+
+
+int main(int const argc, char* const argv[])
+{
+  // Set option defaults
+  server::ServerSettings settings;
+  settings.port = 4000;
+  settings.game_settings.gravity = true;
+  settings.game_settings.preview_size = 6;
+  settings.game_settings.seed = 0;
+  std::string log_path;
+
+  // Process command line options
+  int opt;
+  while ((opt = getopt_long(argc, argv, OPTSTRING, LONGOPTS, nullptr)) != -1)
+  {
+    switch(opt)
+    {
+      case 'u': // --unix
+        settings.unix_path = optarg;
+        break;
+
+      case 'p': // --port
+        settings.port = atoi(optarg);
+        break;
+
+      case 'j': // --threads
+        settings.threads = atoi(optarg);
+        break;
+
+      case 256: // --max-sessions
+        settings.max_sessions = atol(optarg);
+        break;
+
+      case 257: // --preview-size
+        settings.game_settings.preview_size = atoi(optarg);
+        break;
+
+      case 258: // --disable-gravity
+        settings.game_settings.gravity = false;
+        break;
+
+      case 259: // --log-file
+        log_path = optarg;
+        break;
+
+      case 'h': // --help
+        print_help(argv[0]);
+        exit(0);
+        break;
+
+      default:
+        print_help(argv[0]);
+        std::cerr << "Aborting." << std::endl;
+        exit(-1);
+        break;
+    }
+  }
+
+  if (settings.game_settings.preview_size < 0 || settings.game_settings.preview_size > 6)
+  {
+    std::cerr << "Error: " << "Preview size must be between 0 and 6." << std::endl;
+    std::cerr << "Aborting." << std::endl;
+    exit(-1);
+  }
+
+  if (!log_path.empty() && !log::open(log_path))
+    std::cerr << "Could not open log file " << log_path << std::endl;
+
+  // Block the signals handled below, so that event loop threads inherit the mask
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  long base_memory = resident_memory();
+  server::Server game_server(settings);
+  if (!game_server.start())
+  {
+    std::cerr << "Error: " << game_server.error << std::endl;
+    std::cerr << "Aborting." << std::endl;
+    exit(-1);
+  }
+
+  if (settings.unix_path.empty())
+    std::printf("Listening on 127.0.0.1:%hu with %zu threads\n", settings.port, game_server.loops.size());
+  else
+    std::printf("Listening on %s with %zu threads\n", settings.unix_path.c_str(), game_server.loops.size());
+  std::fflush(stdout);
+
+  // Serve until interrupted, printing statistics on request
+  int signal_number = 0;
+  while (sigwait(&signals, &signal_number) == 0 && signal_number == SIGUSR1)
+    print_stats(game_server, base_memory);
+
+  print_stats(game_server, base_memory);
+  game_server.stop();
+  return 0;
+}
@@ -0,0 +1,282 @@
+#include "tetris_ansi.hpp"
+#include "tetris_game.hpp"
+#include "tetris_session.hpp"
+#include <cstdio>
+#include <string>
+
+
+using namespace tetris;
+using namespace tetris::ansi;
+
+
+namespace
+{
+  /* Cell value that never occurs in a built frame, marking a cell as needing a repaint */
+  const Cell STALE_CELL = 0xFF;
+
+  /* Append a Select Graphic Rendition sequence setting colors to out. */
+  void set_colors(std::string& out, short foreground, short background)
+  {
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "\x1b[3%hd;4%hdm", foreground, background);
+    out += buffer;
+  }
+
+  /* Append one playfield cell, drawn like the ncurses UI, to out. */
+  void draw_cell(std::string& out, Cell cell)
+  {
+    if (cell == CellLayer::NONE)
+    {
+      out += ". ";
+      return;
+    }
+
+    short layer = cell & ~7;
+    short color = MINO_COLOR[cell & 7];
+    if (layer == CellLayer::GHOST)
+    {
+      set_colors(out, color, 9);
+      out += "[]";
+    }
+    else if (layer == CellLayer::ACTIVE)
+    {
+      set_colors(out, color, color);
+      out += "..";
+    }
+    else
+    {
+      set_colors(out, color, color);
+      out += "  ";
+    }
+    out += "\x1b[0m";
+  }
+}
+
+
+/* Renderer Class Methods */
+
+Renderer::Renderer(short preview_size_init)
+  : preview_size(preview_size_init),
+    preview_box_info(PREVIEW_BOX_INFO)
+{
+  preview_box_info.height = 3 * preview_size + 3;
+  invalidate();
+}
+
+void Renderer::draw(const session::Session& session, std::string& out)
+{
+  const game::Game& game = session.game;
+
+  if (!drawn)
+    draw_layout(out);
+
+  // Playfield, or the pause screen in its place
+  if (session.paused)
+  {
+    if (!drawn_paused)
+    {
+      clear_box(out, PLAY_BOX_INFO);
+      draw_centered(out, PLAY_BOX_INFO, PLAY_BOX_INFO.height / 2, "PAUSED");
+      for (std::array<Cell, game::Playfield::WIDTH>& row : drawn_frame)
+        row.fill(STALE_CELL);
+      drawn_paused = true;
+    }
+  }
+  else
+  {
+    drawn_paused = false;
+
+    const short first_row = game::Playfield::FIRST_VISIBLE_ROW;
+    Frame frame;
+    for (short i=first_row; i<game::Playfield::HEIGHT; i++)
+      for (short j=0; j<game::Playfield::WIDTH; j++)
+        frame[i-first_row][j] = CellLayer::LOCKED + (Cell)game.playfield[i][j];
+
+    for (const game::Point& p : game.active_tetrimino.get_landing(game.playfield).points)
+      if (p.row >= first_row)
+        frame[p.row-first_row][p.col] = CellLayer::GHOST + (Cell)game.active_tetrimino.type;
+
+    for (const game::Point& p : game.active_tetrimino.points)
+      if (p.row >= first_row)
+        frame[p.row-first_row][p.col] = CellLayer::ACTIVE + (Cell)game.active_tetrimino.type;
+
+    // Emit only changed cells, moving the cursor only where they are not adjacent
+    short cursor_row = -1;
+    short cursor_col = -1;
+    for (short i=0; i<game::Playfield::VISIBLE_ROWS; i++)
+    {
+      for (short j=0; j<game::Playfield::WIDTH; j++)
+      {
+        if (frame[i][j] == drawn_frame[i][j])
+          continue;
+
+        short row = PLAY_BOX_INFO.top + 1 + i;
+        short col = PLAY_BOX_INFO.left + 1 + 2 * j;
+        if (row != cursor_row || col != cursor_col)
+          move_cursor(out, row, col);
+        draw_cell(out, frame[i][j]);
+        cursor_row = row;
+        cursor_col = col + 2;
+
+        drawn_frame[i][j] = frame[i][j];
+      }
+    }
+  }
+
+  // Score
+  if (game.score != drawn_score
+      || game.total_rows_cleared != drawn_rows
+      || game.level != drawn_level)
+  {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "Score: %-8ld", game.score);
+    move_cursor(out, SCORE_BOX_INFO.top + 1, SCORE_BOX_INFO.left + 2);
+    out += buffer;
+    std::snprintf(buffer, sizeof(buffer), "Rows:  %-8hd", game.total_rows_cleared);
+    move_cursor(out, SCORE_BOX_INFO.top + 2, SCORE_BOX_INFO.left + 2);
+    out += buffer;
+    std::snprintf(buffer, sizeof(buffer), "Level: %-8hd", game.level);
+    move_cursor(out, SCORE_BOX_INFO.top + 3, SCORE_BOX_INFO.left + 2);
+    out += buffer;
+
+    drawn_score = game.score;
+    drawn_rows = game.total_rows_cleared;
+    drawn_level = game.level;
+  }
+
+  // Hold
+  if (game.held_tetrimino.type != drawn_hold)
+  {
+    clear_box(out, HOLD_BOX_INFO);
+    draw_box_tetrimino(out, HOLD_BOX_INFO, game.held_tetrimino.type, 0);
+    drawn_hold = game.held_tetrimino.type;
+  }
+
+  // Preview
+  bool preview_changed = false;
+  for (short i=0; i<preview_size; i++)
+    preview_changed |= game.bag.tetrimino_queue[i].type != drawn_preview[i];
+
+  if (preview_changed)
+  {
+    clear_box(out, preview_box_info);
+    short row_offset = 0;
+    for (short i=0; i<preview_size; i++)
+    {
+      game::TetriminoType type = game.bag.tetrimino_queue[i].type;
+      draw_box_tetrimino(out, preview_box_info, type, row_offset);
+      row_offset += type == game::TetriminoType::I ? 2 : 3;
+      drawn_preview[i] = type;
+    }
+  }
+}
+
+void Renderer::draw_game_over(std::string& out)
+{
+  clear_box(out, PLAY_BOX_INFO);
+  short row = PLAY_BOX_INFO.height / 2 - 2;
+  draw_centered(out, PLAY_BOX_INFO, row, "GAME OVER");
+  draw_centered(out, PLAY_BOX_INFO, row + 2, "[r] Retry");
+  draw_centered(out, PLAY_BOX_INFO, row + 3, "[q] Quit");
+
+  for (std::array<Cell, game::Playfield::WIDTH>& frame_row : drawn_frame)
+    frame_row.fill(STALE_CELL);
+}
+
+void Renderer::draw_layout(std::string& out)
+{
+  invalidate();
+
+  // Reset attributes, clear the screen and hide the cursor
+  out += "\x1b[0m\x1b[2J\x1b[?25l";
+  draw_box(out, SCORE_BOX_INFO);
+  draw_box(out, HOLD_BOX_INFO);
+  draw_box(out, PLAY_BOX_INFO);
+  draw_box(out, preview_box_info);
+  drawn = true;
+}
+
+void Renderer::invalidate()
+{
+  drawn = false;
+  for (std::array<Cell, game::Playfield::WIDTH>& row : drawn_frame)
+    row.fill(STALE_CELL);
+  drawn_score = -1;
+  drawn_rows = -1;
+  drawn_level = -1;
+  drawn_hold = game::TetriminoType::NONE;
+  drawn_preview.fill(game::TetriminoType::NONE);
+  drawn_paused = false;
+}
+
+
+/* Free Functions */
+
+void tetris::ansi::move_cursor(std::string& out, short row, short col)
+{
+  char buffer[16];
+  std::snprintf(buffer, sizeof(buffer), "\x1b[%hd;%hdH", row, col);
+  out += buffer;
+}
+
+void tetris::ansi::draw_box(std::string& out, const BoxInfo& box_info)
+{
+  std::string horizontal;
+  for (short i=0; i<box_info.width-2; i++)
+    horizontal += "─";
+
+  move_cursor(out, box_info.top, box_info.left);
+  out += "┌" + horizontal + "┐";
+  for (short i=1; i<box_info.height-1; i++)
+  {
+    move_cursor(out, box_info.top + i, box_info.left);
+    out += "│";
+    move_cursor(out, box_info.top + i, box_info.left + box_info.width - 1);
+    out += "│";
+  }
+  move_cursor(out, box_info.top + box_info.height - 1, box_info.left);
+  out += "└" + horizontal + "┘";
+}
+
+void tetris::ansi::clear_box(std::string& out, const BoxInfo& box_info)
+{
+  std::string blank(box_info.width - 2, ' ');
+  for (short i=1; i<box_info.height-1; i++)
+  {
+    move_cursor(out, box_info.top + i, box_info.left + 1);
+    out += blank;
+  }
+}
+
+void tetris::ansi::draw_centered(std::string& out,
+                                 const BoxInfo& box_info,
+                                 short row,
+                                 const std::string& text)
+{
+  move_cursor(out, box_info.top + row, box_info.left + box_info.width / 2 - text.length() / 2);
+  out += text;
+}
+
+void tetris::ansi::draw_box_tetrimino(std::string& out,
+                                      const BoxInfo& box_info,
+                                      game::TetriminoType type,
+                                      short row_offset)
+{
+  if (type == game::TetriminoType::NONE)
+    return;
+
+  // Same placement as the ncurses hold and preview windows
+  game::Tetrimino tetrimino(type);
+  short color = MINO_COLOR[(short)type];
+  for (const game::Point& p : tetrimino.points)
+  {
+    short row = 2 + 1 + p.row - game::Playfield::FIRST_VISIBLE_ROW + row_offset;
+    short col = -4 + 1 + p.col * 2;
+    if (type == game::TetriminoType::I)
+      row -= 1;
+
+    move_cursor(out, box_info.top + row, box_info.left + col);
+    set_colors(out, color, color);
+    out += "..\x1b[0m";
+  }
+}
@@ -0,0 +1,108 @@
+#ifndef TETRIS_ANSI_HPP
+#define TETRIS_ANSI_HPP
+
+#include "tetris_game.hpp"
+#include "tetris_session.hpp"
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace tetris
+{
+  namespace ansi
+  {
+    /* Location and size of a box on the terminal, in 1-based terminal coordinates */
+    struct BoxInfo
+    {
+      short top, left;
+      short height, width;
+    };
+
+    /* Box constants, laid out like the ncurses UI with the score box in the top-left corner */
+    const BoxInfo SCORE_BOX_INFO{1, 1, 5, 20};
+    const BoxInfo HOLD_BOX_INFO{6, 7, 6, 14};
+    const BoxInfo PLAY_BOX_INFO{1, 23, 23, 22};
+    const BoxInfo PREVIEW_BOX_INFO{1, 47, 21, 14};
+
+    /* Table of (tetrimino type -> ANSI color number) */
+    const std::array<short, 8> MINO_COLOR{9, 7, 6, 5, 3, 4, 2, 1};
+
+    /* Contents of one drawn playfield cell: NONE, or a tetrimino type offset by its layer */
+    using Cell = std::uint8_t;
+    namespace CellLayer
+    {
+      const Cell NONE   = 0;
+      const Cell LOCKED = 0;
+      const Cell GHOST  = 8;
+      const Cell ACTIVE = 16;
+    }
+
+    /* Visible playfield rows (FIRST_VISIBLE_ROW to the floor) */
+    using Frame = std::array<std::array<Cell, game::Playfield::WIDTH>, game::Playfield::VISIBLE_ROWS>;
+
+    /* Draws a session to a terminal as ANSI escape sequences.
+     *
+     * Keeps what it last drew, so that each call only emits what has changed since. One
+     * renderer per terminal; nothing is shared between renderers.
+     */
+    struct Renderer
+    {
+      short preview_size;
+      BoxInfo preview_box_info;
+
+      // What is currently on the terminal
+      bool drawn = false;
+      Frame drawn_frame;
+      long drawn_score = -1;
+      short drawn_rows = -1;
+      short drawn_level = -1;
+      game::TetriminoType drawn_hold = game::TetriminoType::NONE;
+      std::array<game::TetriminoType, 6> drawn_preview{};
+      bool drawn_paused = false;
+
+      Renderer(short preview_size_init);
+
+      /* Draw a session, appending the escape sequences to out.
+       *
+       * session[in]: Session to draw.
+       * out[out]: Terminal output, appended to.
+       */
+      void draw(const session::Session& session, std::string& out);
+
+      /* Draw the game-over screen over the playfield, appending to out. */
+      void draw_game_over(std::string& out);
+
+      /* Clear the terminal and draw the empty boxes, appending to out. */
+      void draw_layout(std::string& out);
+
+      /* Forget what was drawn, so the next draw starts from a cleared terminal. */
+      void invalidate();
+    };
+
+    /* Append a cursor movement to out. */
+    void move_cursor(std::string& out, short row, short col);
+
+    /* Append a box outline to out. */
+    void draw_box(std::string& out, const BoxInfo& box_info);
+
+    /* Append spaces over the inside of a box to out. */
+    void clear_box(std::string& out, const BoxInfo& box_info);
+
+    /* Append a row of text centered in a box to out. */
+    void draw_centered(std::string& out, const BoxInfo& box_info, short row, const std::string& text);
+
+    /* Append a tetrimino as shown in the hold and preview boxes to out.
+     *
+     * out[out]: Terminal output, appended to.
+     * box_info[in]: Box to draw in.
+     * type[in]: Type of tetrimino to draw.
+     * row_offset[in]: Rows below the first slot in the box to draw at.
+     */
+    void draw_box_tetrimino(std::string& out,
+                            const BoxInfo& box_info,
+                            game::TetriminoType type,
+                            short row_offset);
+  }
+}
+
+#endif
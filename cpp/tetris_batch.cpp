@@ -0,0 +1,205 @@
+#include "tetris_batch.hpp"
+#include "tetris_dataset.hpp"
+#include "tetris_pool.hpp"
+#include "tetris_session.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+
+using namespace tetris;
+using namespace tetris::batch;
+
+
+/* SearchCounters Class Methods */
+
+SearchCounters& SearchCounters::operator+=(const SearchCounters& right_op)
+{
+  searches += right_op.searches;
+  nodes += right_op.nodes;
+  depth_total += right_op.depth_total;
+  seconds += right_op.seconds;
+  return *this;
+}
+
+
+/* Policy Class Methods */
+
+SearchCounters Policy::counters() const
+{
+  return SearchCounters();
+}
+
+
+/* RandomPolicy Class Methods */
+
+RandomPolicy::RandomPolicy(std::uint64_t seed)
+  : random_generator(seed)
+{}
+
+session::Command RandomPolicy::next_command(const session::Session& session)
+{
+  // Plan a new placement whenever a new tetrimino becomes active
+  if (planned_tetrimino != session.game.total_tetriminoes_locked)
+  {
+    planned_tetrimino = session.game.total_tetriminoes_locked;
+    plan_length = 0;
+    plan_position = 0;
+
+    short rotations = random_generator.below(4);
+    short shift = (short)random_generator.below(11) - 5;
+
+    for (short i=0; i<rotations; i++)
+      plan[plan_length++] = session::Command::ROTATE_CW;
+    for (short i=0; i<std::abs(shift); i++)
+      plan[plan_length++] = shift < 0 ? session::Command::SHIFT_LEFT : session::Command::SHIFT_RIGHT;
+    plan[plan_length++] = session::Command::HARD_DROP;
+  }
+
+  if (plan_position < plan_length)
+    return plan[plan_position++];
+
+  return session::Command::DO_NOTHING;
+}
+
+
+/* Free Functions */
+
+std::uint64_t tetris::batch::game_seed(std::uint64_t batch_seed, long game_index)
+{
+  std::uint64_t z = batch_seed + (game_index + 1) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+GameStats tetris::batch::play_game(const session::GameSettings& settings,
+                                   std::uint64_t seed,
+                                   Policy& policy,
+                                   long max_tetriminoes,
+                                   dataset::Writer* writer,
+                                   std::uint32_t game_index)
+{
+  session::GameSettings game_settings = settings;
+  game_settings.seed = seed;
+  session::Session session(game_settings);
+  const game::Game& game = session.game;
+
+  // State and score when the active tetrimino was drawn, for its dataset record
+  dataset::Record record;
+  long start_score = 0;
+  if (writer)
+    dataset::capture_state(game, record);
+
+  while (!session.is_over()
+         && (max_tetriminoes == 0 || game.total_tetriminoes_locked < max_tetriminoes))
+  {
+    session::Command command = policy.next_command(session);
+    if (!writer)
+    {
+      session.step(command);
+      continue;
+    }
+
+    // Stepping in two halves exposes the tetrimino as it is about to lock
+    short events = session.apply(command);
+    game::Tetrimino placement = game.active_tetrimino;
+    events |= session.advance();
+    if (events & session::StepEvent::LOCKED)
+    {
+      record.placement = dataset::Placement{(std::uint8_t)placement.type,
+                                             (std::uint8_t)placement.facing,
+                                             (std::int8_t)placement.pivot.row,
+                                             (std::int8_t)placement.pivot.col};
+      record.score_delta = game.score - start_score;
+      record.game = game_index;
+      record.piece = game.total_tetriminoes_locked - 1;
+      writer->add(record);
+
+      dataset::capture_state(game, record);
+      start_score = game.score;
+    }
+  }
+
+  return GameStats{game.score,
+                   game.level,
+                   game.total_rows_cleared,
+                   game.total_tetriminoes_locked,
+                   session.frame,
+                   policy.counters()};
+}
+
+BatchResult tetris::batch::run_batch(const BatchSettings& settings, const PolicyFactory& make_policy)
+{
+  pool::ThreadPool thread_pool(settings.threads);
+
+  BatchResult result;
+  result.games.resize(settings.games);
+  result.threads = thread_pool.size();
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  thread_pool.parallel_for(
+    settings.games,
+    [&] (long index, unsigned)
+    {
+      std::uint64_t seed = game_seed(settings.seed, index);
+      std::unique_ptr<Policy> policy = make_policy(seed);
+      if (settings.exporter)
+      {
+        dataset::Writer writer(*settings.exporter);
+        result.games[index] = play_game(settings.game_settings, seed, *policy,
+                                        settings.max_tetriminoes, &writer, index);
+      }
+      else
+      {
+        result.games[index] = play_game(settings.game_settings, seed, *policy,
+                                        settings.max_tetriminoes);
+      }
+    });
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  result.seconds = elapsed.count();
+
+  return result;
+}
+
+Distribution tetris::batch::summarize(const std::vector<GameStats>& games,
+                                      const std::function<double(const GameStats&)>& statistic)
+{
+  std::vector<double> values;
+  values.reserve(games.size());
+  for (const GameStats& game : games)
+    values.push_back(statistic(game));
+  return summarize(std::move(values));
+}
+
+Distribution tetris::batch::summarize(std::vector<double> values)
+{
+  Distribution distribution{0, 0, 0, 0, 0, 0};
+  if (values.empty())
+    return distribution;
+
+  std::sort(values.begin(), values.end());
+
+  double total = 0;
+  for (double value : values)
+    total += value;
+
+  auto percentile = [&values] (double fraction)
+  {
+    return values[(size_t)(fraction * (values.size() - 1) + 0.5)];
+  };
+
+  distribution.min = values.front();
+  distribution.mean = total / values.size();
+  distribution.p50 = percentile(0.50);
+  distribution.p90 = percentile(0.90);
+  distribution.p99 = percentile(0.99);
+  distribution.max = values.back();
+
+  return distribution;
+}
@@ -0,0 +1,134 @@
+#ifndef TETRIS_BATCH_HPP
+#define TETRIS_BATCH_HPP
+
+#include "tetris_dataset.hpp"
+#include "tetris_game.hpp"
+#include "tetris_session.hpp"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace tetris
+{
+  namespace batch
+  {
+    /* Effort spent by a policy searching for moves */
+    struct SearchCounters
+    {
+      long searches = 0;
+      long nodes = 0;
+      long depth_total = 0;
+      double seconds = 0;
+
+      SearchCounters& operator+=(const SearchCounters& right_op);
+    };
+
+    /* Chooses the commands sent by a simulated player. */
+    struct Policy
+    {
+      virtual ~Policy() = default;
+
+      /* Choose the command to send during the session's current frame. */
+      virtual session::Command next_command(const session::Session& session) = 0;
+
+      /* Get the search effort spent so far, for policies that search. */
+      virtual SearchCounters counters() const;
+    };
+
+    /* Policy that places each tetrimino with a random rotation and column, then hard
+     * drops it.
+     */
+    struct RandomPolicy : Policy
+    {
+      game::Random random_generator;
+      std::array<session::Command, 16> plan;
+      short plan_length = 0;
+      short plan_position = 0;
+      long planned_tetrimino = -1;
+
+      RandomPolicy(std::uint64_t seed);
+
+      session::Command next_command(const session::Session& session) override;
+    };
+
+    /* Creates a fresh policy for each game, given that game's seed. */
+    using PolicyFactory = std::function<std::unique_ptr<Policy>(std::uint64_t seed)>;
+
+    /* Settings for a batch of games */
+    struct BatchSettings
+    {
+      session::GameSettings game_settings;
+      long games;
+      unsigned threads;
+      std::uint64_t seed;
+      long max_tetriminoes;
+      dataset::Exporter* exporter = nullptr; // If not null, receives a record of every lock
+    };
+
+    /* Statistics from one finished game */
+    struct GameStats
+    {
+      long score;
+      short level;
+      short rows;
+      long tetriminoes;
+      long frames;
+      SearchCounters search;
+    };
+
+    /* Summary of the distribution of one statistic over a batch */
+    struct Distribution
+    {
+      double min, mean, p50, p90, p99, max;
+    };
+
+    /* Results of a batch of games */
+    struct BatchResult
+    {
+      std::vector<GameStats> games;
+      unsigned threads;
+      double seconds;
+    };
+
+    /* Derive the seed for one game of a batch.
+     *
+     * Seeds are spread with splitmix64 so that neighbouring games do not get correlated
+     * bags.
+     */
+    std::uint64_t game_seed(std::uint64_t batch_seed, long game_index);
+
+    /* Play one game to completion.
+     *
+     * settings[in]: Settings for the game.
+     * seed[in]: Seed for the game's bag, overriding settings.seed.
+     * policy[in]: Policy choosing the player's commands.
+     * max_tetriminoes[in]: Stop the game after this many tetriminoes lock (0 for no limit).
+     * writer[out]: If not null, receives a dataset record for every tetrimino locked.
+     * game_index[in]: Index of the game within its batch, stored in each record.
+     */
+    GameStats play_game(const session::GameSettings& settings,
+                        std::uint64_t seed,
+                        Policy& policy,
+                        long max_tetriminoes,
+                        dataset::Writer* writer=nullptr,
+                        std::uint32_t game_index=0);
+
+    /* Play a batch of independent games across a thread pool.
+     *
+     * Each game has its own session and policy and writes only its own result slot, so
+     * games share no mutable state while they run.
+     */
+    BatchResult run_batch(const BatchSettings& settings, const PolicyFactory& make_policy);
+
+    /* Summarize one statistic over all games of a batch. */
+    Distribution summarize(const std::vector<GameStats>& games,
+                           const std::function<double(const GameStats&)>& statistic);
+
+    /* Summarize a list of values. */
+    Distribution summarize(std::vector<double> values);
+  }
+}
+
+#endif
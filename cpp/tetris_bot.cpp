@@ -0,0 +1,382 @@
+#include "tetris_bot.hpp"
+#include "tetris_game.hpp"
+#include "tetris_log.hpp"
+#include "tetris_movegen.hpp"
+#include "tetris_pool.hpp"
+#include "tetris_session.hpp"
+#include "tetris_table.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+
+using namespace tetris;
+using namespace tetris::bot;
+
+
+/* Node Class Methods */
+
+std::uint64_t Node::hash() const
+{
+  // The queue index stands in for the bag position, as every node shares the same bag
+  return playfield.hash
+    ^ game::zobrist_key(game::KeyTag::TETRIMINO, (std::uint64_t)current)
+    ^ game::zobrist_key(game::KeyTag::HELD, (std::uint64_t)hold)
+    ^ game::zobrist_key(game::KeyTag::BAG, queue_index);
+}
+
+
+/* Bot Class Methods */
+
+Bot::Bot(const BotSettings& settings_init)
+  : settings(settings_init),
+    path_generator(std::make_unique<movegen::MoveGenerator>())
+{
+  unsigned worker_count = 1;
+  if (settings.threads != 1)
+  {
+    thread_pool = std::make_unique<pool::ThreadPool>(settings.threads);
+    worker_count = thread_pool->size();
+  }
+
+  workers.resize(worker_count);
+  for (Worker& worker : workers)
+    worker.generator = std::make_unique<movegen::MoveGenerator>();
+}
+
+Decision Bot::search(const session::Session& session, std::chrono::duration<float> budget)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  const game::Game& game = session.game;
+
+  // Only look as far ahead as the player can see
+  QueueView queue;
+  queue.size = std::min<short>(session.settings.preview_size, queue.types.size());
+  for (short i=0; i<queue.size; i++)
+    queue.types[i] = game.bag.tetrimino_queue[i].type;
+
+  Node root;
+  root.playfield = game.playfield;
+  root.current = game.active_tetrimino.type;
+  root.hold = game.held_tetrimino.type;
+  root.queue_index = 0;
+  root.reward = 0;
+  root.value = 0;
+  root.root = -1;
+
+  // Expand the root, recording the decision that leads to each child
+  root_decisions.clear();
+  beam.clear();
+  expand(root, game.hold_available, queue, *workers[0].generator, beam, true);
+  remove_duplicates();
+
+  last_search = batch::SearchCounters();
+  last_search.searches = 1;
+  last_search.nodes = beam.size();
+
+  short depth = 1;
+  std::chrono::duration<float> last_depth_time = std::chrono::steady_clock::now() - start;
+  while (depth < settings.max_depth && !beam.empty() && beam[0].current != game::TetriminoType::NONE)
+  {
+    // Stop if the next depth is not expected to fit in the budget
+    std::chrono::steady_clock::time_point depth_start = std::chrono::steady_clock::now();
+    if (budget.count() > 0 && (depth_start - start) + last_depth_time > budget)
+      break;
+
+    // Keep the best beam_width nodes, breaking ties by beam order
+    ranked.clear();
+    for (const Node& node : beam)
+      ranked.push_back(&node);
+    if ((short)ranked.size() > settings.beam_width)
+    {
+      std::nth_element(ranked.begin(), ranked.begin() + settings.beam_width, ranked.end(),
+                       [] (const Node* a, const Node* b)
+                       {
+                         return a->value > b->value || (a->value == b->value && a < b);
+                       });
+      ranked.resize(settings.beam_width);
+    }
+
+    // Expand the beam in parallel, each node into its own slot
+    if (expansions.size() < ranked.size())
+      expansions.resize(ranked.size());
+
+    auto expand_node = [&] (long index, unsigned worker)
+    {
+      expansions[index].clear();
+      expand(*ranked[index], true, queue, *workers[worker].generator, expansions[index], false);
+    };
+    if (thread_pool)
+      thread_pool->parallel_for(ranked.size(), expand_node);
+    else
+      for (long i=0; i<(long)ranked.size(); i++)
+        expand_node(i, 0);
+
+    size_t child_count = 0;
+    for (size_t i=0; i<ranked.size(); i++)
+      child_count += expansions[i].size();
+    if (child_count == 0)
+      break;
+
+    // Join the slots in beam order, whichever threads filled them
+    beam.clear();
+    for (size_t i=0; i<ranked.size(); i++)
+      beam.insert(beam.end(), expansions[i].begin(), expansions[i].end());
+    remove_duplicates();
+
+    last_search.nodes += beam.size();
+    last_depth_time = std::chrono::steady_clock::now() - depth_start;
+    ++depth;
+  }
+
+  // Follow the best node back to its first decision
+  Decision decision;
+  if (!beam.empty())
+  {
+    const Node& best = *std::max_element(beam.begin(), beam.end(),
+                                         [] (const Node& a, const Node& b) { return a.value < b.value; });
+    decision = root_decisions[best.root];
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  last_search.depth_total = depth;
+  last_search.seconds = elapsed.count();
+  totals += last_search;
+
+  TETRIS_LOG_DEBUG("Bot searched " << last_search.nodes << " nodes to depth " << depth
+                   << " in " << last_search.seconds * 1000 << " ms");
+
+  return decision;
+}
+
+void Bot::expand(const Node& node,
+                 bool hold_available,
+                 const QueueView& queue,
+                 movegen::MoveGenerator& generator,
+                 std::vector<Node>& children,
+                 bool record_roots)
+{
+  // Either place the current tetrimino, or hold it and place the alternative
+  for (bool use_hold : {false, true})
+  {
+    game::TetriminoType type = node.current;
+    game::TetriminoType hold = node.hold;
+    short queue_index = node.queue_index;
+
+    if (use_hold)
+    {
+      if (!hold_available)
+        continue;
+
+      hold = node.current;
+      if (node.hold != game::TetriminoType::NONE)
+        type = node.hold;
+      else if (queue_index < queue.size)
+        type = queue.types[queue_index++];
+      else
+        continue;
+
+      if (type == node.current)
+        continue;
+    }
+
+    game::TetriminoType next = queue_index < queue.size
+      ? queue.types[queue_index]
+      : game::TetriminoType::NONE;
+
+    short placement_count = generator.generate(game::Tetrimino(type), node.playfield);
+    for (short i=0; i<placement_count; i++)
+    {
+      game::Tetrimino placement = generator.placements[i].tetrimino();
+
+      bool topped_out = false;
+      for (const game::Point& p : placement.points)
+        topped_out |= p.row < TOP_OUT_ROW;
+      if (topped_out)
+        continue;
+
+      children.emplace_back();
+      Node& child = children.back();
+      child.playfield = node.playfield;
+      for (const game::Point& p : placement.points)
+        child.playfield.set(p, type);
+      short rows_cleared = child.playfield.clear_full_rows();
+
+      // Drop children where the next tetrimino could not spawn
+      if (next != game::TetriminoType::NONE
+          && game::check_collision(game::Tetrimino(next).points, child.playfield) != game::CollisionResult::NONE)
+      {
+        children.pop_back();
+        continue;
+      }
+
+      child.current = next;
+      child.hold = hold;
+      child.queue_index = next != game::TetriminoType::NONE ? queue_index + 1 : queue_index;
+      child.reward = node.reward + ROWS_WEIGHT * rows_cleared;
+      child.value = child.reward + evaluate(child.playfield);
+      child.root = node.root;
+
+      if (record_roots)
+      {
+        child.root = root_decisions.size();
+        Decision decision;
+        decision.valid = true;
+        decision.hold = use_hold;
+        decision.placement = placement;
+        root_decisions.push_back(decision);
+      }
+    }
+  }
+}
+
+void Bot::remove_duplicates()
+{
+  // Entries from earlier calls are ignored rather than cleared. Data is the generation
+  // above the beam index of the best node found so far for the position.
+  ++table_generation;
+
+  size_t kept = 0;
+  for (size_t i=0; i<beam.size(); i++)
+  {
+    const Node& node = beam[i];
+    std::uint64_t key = node.hash();
+    std::uint64_t data;
+    if (transpositions.probe(key, data) && (data >> 32) == table_generation)
+    {
+      // The earlier node wins a tie, so it is only replaced by a strictly better one
+      Node& best = beam[(std::uint32_t)data];
+      if (node.value > best.value || (node.value == best.value && node.root < best.root))
+        best = node;
+      continue;
+    }
+
+    transpositions.store(key, (std::uint64_t)table_generation << 32 | kept);
+    if (kept != i)
+      beam[kept] = node;
+    ++kept;
+  }
+  beam.resize(kept);
+}
+
+session::Command Bot::next_command(const session::Session& session)
+{
+  const game::Game& game = session.game;
+  if (session.paused)
+    return session::Command::DO_NOTHING;
+
+  // Decide once for each new tetrimino
+  if (planned_tetrimino != game.total_tetriminoes_locked)
+  {
+    planned_tetrimino = game.total_tetriminoes_locked;
+
+    std::chrono::duration<float> budget = settings.max_think_time;
+    if (budget.count() > 0 && session.settings.gravity)
+    {
+      float rows_per_frame = game.get_gravity() / (float)game::GRAVITY_ONE;
+      budget = std::min(budget, session::TICK_DURATION / rows_per_frame);
+    }
+
+    Decision decision = search(session, budget);
+    has_plan = decision.valid;
+    hold_pending = decision.valid && decision.hold;
+    path_state = 0;
+    if (has_plan)
+      target_key = movegen::cell_key(decision.placement);
+  }
+
+  if (hold_pending)
+  {
+    hold_pending = false;
+    return session::Command::HOLD;
+  }
+
+  if (!has_plan)
+    return session::Command::HARD_DROP;
+
+  // Search again only once the tetrimino has left the path, e.g. because gravity moved
+  // it or a move failed
+  if (game.active_tetrimino.hash() != path_state && !find_path(game))
+    return session::Command::HARD_DROP;
+
+  session::Command command = path[path_step++];
+  game::Tetrimino next = game.active_tetrimino;
+  switch (command)
+  {
+    case session::Command::SHIFT_LEFT:
+      next.translate(game::Point(0, -1), game.playfield);
+      break;
+
+    case session::Command::SHIFT_RIGHT:
+      next.translate(game::Point(0, 1), game.playfield);
+      break;
+
+    case session::Command::ROTATE_CCW:
+      next.rotate_ccw(game.playfield);
+      break;
+
+    case session::Command::ROTATE_CW:
+      next.rotate_cw(game.playfield);
+      break;
+
+    case session::Command::SOFT_DROP:
+      next.translate(game::Point(1, 0), game.playfield);
+      break;
+
+    default:
+      break;
+  }
+  path_state = path_step < path_length ? next.hash() : 0;
+  return command;
+}
+
+bool Bot::find_path(const game::Game& game)
+{
+  path_state = 0;
+  short placement_count = path_generator->generate(game.active_tetrimino, game.playfield, true);
+  for (short i=0; i<placement_count; i++)
+  {
+    const movegen::Placement& placement = path_generator->placements[i];
+    if (movegen::cell_key(placement.tetrimino()) == target_key && placement.path_length > 0)
+    {
+      path = placement.path;
+      path_length = placement.path_length;
+      path_step = 0;
+      path_state = game.active_tetrimino.hash();
+      return true;
+    }
+  }
+
+  // Target no longer reachable
+  return false;
+}
+
+batch::SearchCounters Bot::counters() const
+{
+  return totals;
+}
+
+
+/* Free Functions */
+
+float tetris::bot::evaluate(const game::Playfield& playfield)
+{
+  short aggregate_height = 0;
+  short holes = 0;
+  short bumpiness = 0;
+  for (short col=0; col<game::Playfield::WIDTH; col++)
+  {
+    aggregate_height += playfield.heights[col];
+    holes += playfield.holes[col];
+    if (col > 0)
+      bumpiness += std::abs(playfield.heights[col] - playfield.heights[col-1]);
+  }
+
+  return HEIGHT_WEIGHT * aggregate_height
+    + HOLES_WEIGHT * holes
+    + BUMPINESS_WEIGHT * bumpiness;
+}
@@ -0,0 +1,172 @@
+#ifndef TETRIS_BOT_HPP
+#define TETRIS_BOT_HPP
+
+#include "tetris_batch.hpp"
+#include "tetris_game.hpp"
+#include "tetris_movegen.hpp"
+#include "tetris_pool.hpp"
+#include "tetris_session.hpp"
+#include "tetris_table.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tetris
+{
+  namespace bot
+  {
+    /* Struct for bot settings */
+    struct BotSettings
+    {
+      short beam_width;
+      short max_depth; // Number of tetriminoes placed along each line of search
+      unsigned threads; // Worker threads for node expansion, or 0 for one per hardware thread
+      std::chrono::duration<float> max_think_time; // Zero to always search to max_depth
+    };
+
+    /* Weights of board features in the evaluation function. */
+    const float HEIGHT_WEIGHT = -0.510066;
+    const float ROWS_WEIGHT = 0.760666;
+    const float HOLES_WEIGHT = -0.35663;
+    const float BUMPINESS_WEIGHT = -0.184483;
+
+    /* Row above which a locked mino is treated as topping out. */
+    const short TOP_OUT_ROW = 20;
+
+    /* Base 2 logarithm of the number of slots in the bot's transposition table. */
+    const short TABLE_SIZE_BITS = 16;
+
+    /* A board position in the search. */
+    struct Node
+    {
+      game::Playfield playfield;
+      game::TetriminoType current;  // Next tetrimino to place
+      game::TetriminoType hold;
+      short queue_index;            // Position in the preview of the tetrimino after current
+      float reward;                 // Accumulated reward for rows cleared
+      float value;                  // Reward plus evaluation of the board
+      short root;                   // Index of the first decision on the path to this node
+
+      /* Get a Zobrist hash of everything that decides the node's future. */
+      std::uint64_t hash() const;
+    };
+
+    /* Choice for the active tetrimino. */
+    struct Decision
+    {
+      bool valid = false;
+      bool hold = false;
+      game::Tetrimino placement;
+    };
+
+    /* Per-thread search memory, reused across searches. */
+    struct Worker
+    {
+      std::unique_ptr<movegen::MoveGenerator> generator;
+    };
+
+    /* Pieces visible to the search: the preview queue. */
+    struct QueueView
+    {
+      std::array<game::TetriminoType, 8> types;
+      short size;
+    };
+
+    /* Beam search player.
+     *
+     * From each position in the beam, every placement of the current tetrimino (and of
+     * the alternative reached by holding) is generated and scored, and the best
+     * beam_width positions go on to the next depth. Node expansion at each depth is split
+     * across a thread pool, with the children of each node written to a slot of their
+     * own and the slots joined in beam order, so the search gives the same result on any
+     * number of threads. The search deepens one tetrimino at a time through the preview
+     * until max_depth is reached, or until the next depth is not expected to finish
+     * within the time budget.
+     *
+     * Different orders of placements often reach the same position. Once the children of
+     * a depth are joined, each is looked up by its hash in a transposition table and only
+     * the best node of each position is kept: the one with the highest value, then the
+     * lowest root decision, then the first in beam order.
+     */
+    struct Bot : batch::Policy
+    {
+      BotSettings settings;
+      std::unique_ptr<pool::ThreadPool> thread_pool;
+      std::vector<Worker> workers;
+      std::vector<Node> beam;
+      std::vector<const Node*> ranked;
+      std::vector<std::vector<Node>> expansions; // Children of each ranked node
+      std::vector<Decision> root_decisions;
+      std::unique_ptr<movegen::MoveGenerator> path_generator;
+      table::TranspositionTable transpositions{TABLE_SIZE_BITS};
+      std::uint32_t table_generation = 0;
+
+      // Plan for the active tetrimino
+      long planned_tetrimino = -1;
+      bool hold_pending = false;
+      bool has_plan = false;
+      std::uint64_t target_key = 0;
+
+      // Path to the target, followed while the tetrimino stays on it
+      std::array<session::Command, movegen::MAX_PATH_LENGTH> path;
+      short path_length = 0;
+      short path_step = 0;
+      std::uint64_t path_state = 0; // Hash of the tetrimino expected before the next step
+
+      // Counters
+      batch::SearchCounters totals;
+      batch::SearchCounters last_search;
+
+      Bot(const BotSettings& settings_init);
+
+      /* Choose where to put the active tetrimino.
+       *
+       * session[in]: Session to decide for.
+       * budget[in]: Time allowed for the search, or zero for no limit.
+       */
+      Decision search(const session::Session& session, std::chrono::duration<float> budget);
+
+      /* Generate and score all children of a node.
+       *
+       * node[in]: Node to expand.
+       * hold_available[in]: Whether the node may use hold.
+       * queue[in]: Tetriminoes visible in the preview.
+       * generator[in,out]: Move generator to use.
+       * children[out]: Appended with every child.
+       * record_roots[in]: Whether node is the root, in which case each child appends
+       *                   its decision to root_decisions. Only valid single-threaded.
+       */
+      void expand(const Node& node,
+                  bool hold_available,
+                  const QueueView& queue,
+                  movegen::MoveGenerator& generator,
+                  std::vector<Node>& children,
+                  bool record_roots);
+
+      /* Keep only the best node of each position in the beam, preserving the order of
+       * those kept.
+       */
+      void remove_duplicates();
+
+      /* Search again for the shortest path to the target and start following it.
+       *
+       * game[in]: Game whose active tetrimino starts the path.
+       *
+       * return: Whether the target can still be reached.
+       */
+      bool find_path(const game::Game& game);
+
+      /* Choose the command to send during the session's current frame. */
+      session::Command next_command(const session::Session& session) override;
+
+      batch::SearchCounters counters() const override;
+    };
+
+    /* Score a board by its aggregate height, holes and bumpiness. */
+    float evaluate(const game::Playfield& playfield);
+  }
+}
+
+#endif
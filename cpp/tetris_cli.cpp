@@ -12,13 +12,37 @@ tetris::cli::HelpFormatter::HelpFormatter(const std::string& run_command)
     "-p, --preview-size SIZE  Set the number of tetriminoes to show in the piece preview." "\n"
     "    --disable-gravity    Pieces will not fall unless soft dropped or hard dropped, and" "\n"
     "                         must be hard dropped to lock in place." "\n"
+    "    --seed SEED          Seed the piece sequence, so that games can be reproduced." "\n"
+    "    --record FILE        Record each game to a replay file: the first to FILE, and" "\n"
+    "                         the Nth after a restart or retry to FILE.N." "\n"
+    "    --replay FILE        Play back a replay file without display, as fast as possible," "\n"
+    "                         and print its result." "\n"
+    "    --bot                Let the built-in beam search bot play." "\n"
+    "    --log-file FILE      Write the log to FILE instead of tetris.log. An empty FILE" "\n"
+    "                         disables logging." "\n"
+    "    --profile FILE       Time each phase of every tick and write a latency report to" "\n"
+    "                         FILE on exit, or whenever SIGUSR1 is received." "\n"
+    "    --autosave FILE      Save the game to FILE each time a tetrimino locks. A FILE" "\n"
+    "                         holding an unfinished game is only overwritten with" "\n"
+    "                         --resume." "\n"
+    "    --resume FILE        Continue the game saved in FILE." "\n"
+    "    --virtual-clock      Run the game on simulated time, as fast as it can be drawn." "\n"
+    "                         Requires --bot." "\n"
+    "    --das FRAMES         Frames a shift key must be held before it repeats" "\n"
+    "                         (default 10). Repeats start no sooner than the" "\n"
+    "                         terminal's own key repeat delay, usually about 30" "\n"
+    "                         frames, whatever FRAMES is." "\n"
+    "    --arr FRAMES         Frames between repeats of a held shift key, or 0 to shift" "\n"
+    "                         straight to the wall (default 2)." "\n"
     "\n"
     "-h                       Display brief help." "\n"
     "--help                   Display detailed help (i.e. this message).";
 
   brief =
     usage + "\n"
-    + "Available opts: --preview_size (-p), --disable-gravity" "\n"
+    + "Available opts: --preview_size (-p), --disable-gravity, --seed, --record, --replay, --bot," "\n"
+    + "                --log-file, --profile, --autosave, --resume, --virtual-clock," "\n"
+    + "                --das, --arr" "\n"
     + "Try '" + run_command + " --help' for more inforation.";
 
   complete =
@@ -27,7 +51,10 @@ tetris::cli::HelpFormatter::HelpFormatter(const std::string& run_command)
     + details;
 }
 
-opterror tetris::cli::process_options(int const argc, char* const argv[], control::GameSettings& settings)
+opterror tetris::cli::process_options(int const argc,
+                                      char* const argv[],
+                                      session::GameSettings& settings,
+                                      RunOptions& run_options)
 {
   opterror rc = opterror_flag::NONE;
 
@@ -46,6 +73,51 @@ opterror tetris::cli::process_options(int const argc, char* const argv[], contro
         settings.gravity = false;
         break;
 
+      case 257: // --seed
+        settings.seed = strtoull(optarg, nullptr, 0);
+        run_options.seed_fixed = true;
+        break;
+
+      case 258: // --record
+        run_options.record_path = optarg;
+        break;
+
+      case 259: // --replay
+        run_options.replay_path = optarg;
+        break;
+
+      case 260: // --bot
+        run_options.bot = true;
+        break;
+
+      case 261: // --log-file
+        run_options.log_path = optarg;
+        break;
+
+      case 262: // --profile
+        run_options.profile_path = optarg;
+        break;
+
+      case 263: // --autosave
+        run_options.autosave_path = optarg;
+        break;
+
+      case 264: // --resume
+        run_options.resume_path = optarg;
+        break;
+
+      case 265: // --virtual-clock
+        run_options.virtual_clock = true;
+        break;
+
+      case 266: // --das
+        run_options.repeat_settings.das_frames = atol(optarg);
+        break;
+
+      case 267: // --arr
+        run_options.repeat_settings.arr_frames = atol(optarg);
+        break;
+
       case 'h':
         std::cout << help.brief << std::endl;
         exit(0);
@@ -79,6 +151,28 @@ opterror tetris::cli::process_options(int const argc, char* const argv[], contro
               << std::endl;
     rc |= opterror_flag::BAD_ARG;
   }
+  if (!run_options.resume_path.empty() && !run_options.record_path.empty())
+  {
+    std::cerr << "Error: "
+              << "A resumed game cannot be recorded, as replays start from the beginning."
+              << std::endl;
+    rc |= opterror_flag::BAD_ARG;
+  }
+  if (run_options.repeat_settings.das_frames < 0 || run_options.repeat_settings.arr_frames < 0)
+  {
+    std::cerr << "Error: "
+              << "DAS and ARR must be non-negative (" << run_options.repeat_settings.das_frames
+              << " and " << run_options.repeat_settings.arr_frames << " attempted)."
+              << std::endl;
+    rc |= opterror_flag::BAD_ARG;
+  }
+  if (run_options.virtual_clock && !run_options.bot)
+  {
+    std::cerr << "Error: "
+              << "The virtual clock does not wait for key presses, so it needs --bot to play."
+              << std::endl;
+    rc |= opterror_flag::BAD_ARG;
+  }
 
   return rc;
 }
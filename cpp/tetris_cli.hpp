@@ -1,7 +1,8 @@
 #ifndef TETRIS_CLI_HPP
 #define TETRIS_CLI_HPP
 
-#include "tetris_control.hpp"
+#include "tetris_input.hpp"
+#include "tetris_session.hpp"
 #include <getopt.h>
 #include <string>
 
@@ -20,13 +21,39 @@ namespace tetris
     }
 
     const char OPTSTRING[5] = "p:Gh";
-    const option LONGOPTS[4] = {
+    const option LONGOPTS[15] = {
       {"preview-size", true, nullptr, 'p'},
       {"disable-gravity", false, nullptr, 256},
+      {"seed", true, nullptr, 257},
+      {"record", true, nullptr, 258},
+      {"replay", true, nullptr, 259},
+      {"bot", false, nullptr, 260},
+      {"log-file", true, nullptr, 261},
+      {"profile", true, nullptr, 262},
+      {"autosave", true, nullptr, 263},
+      {"resume", true, nullptr, 264},
+      {"virtual-clock", false, nullptr, 265},
+      {"das", true, nullptr, 266},
+      {"arr", true, nullptr, 267},
       {"help", false, nullptr, 1024},
       {0, 0, 0, 0},
     };
 
+    /* Options controlling a run of the program, rather than an individual game */
+    struct RunOptions
+    {
+      bool seed_fixed = false;
+      std::string record_path;
+      std::string replay_path;
+      bool bot = false;
+      std::string log_path = "tetris.log"; // Empty to disable logging
+      std::string profile_path;            // Empty to disable profiling
+      std::string autosave_path;           // Empty to disable autosaving
+      std::string resume_path;
+      bool virtual_clock = false;
+      input::RepeatSettings repeat_settings = input::DEFAULT_REPEAT_SETTINGS;
+    };
+
     struct HelpFormatter
     {
       std::string usage;
@@ -37,7 +64,10 @@ namespace tetris
       HelpFormatter(const std::string& run_command);
     };
 
-    opterror process_options(int const argc, char* const argv[], control::GameSettings& settings);
+    opterror process_options(int const argc,
+                             char* const argv[],
+                             session::GameSettings& settings,
+                             RunOptions& run_options);
   }
 }
 
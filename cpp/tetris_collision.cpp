@@ -0,0 +1,169 @@
+#include "tetris_collision.hpp"
+#include "tetris_game.hpp"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <array>
+#include <cstdint>
+
+
+using namespace tetris;
+using namespace tetris::collision;
+
+
+namespace
+{
+  /* Playfield columns are widened so that walls, floor and the space above the playfield
+   * can be tested the same way as minoes. Bit (row + EXTENDED_ROW_OFFSET) of extended
+   * column (col + EXTENDED_COL_OFFSET) is set for every cell a mino may not occupy.
+   */
+  const short EXTENDED_ROW_OFFSET = 8;
+  const short EXTENDED_COL_OFFSET = 8;
+  const short EXTENDED_COLS = 32;
+
+  using ExtendedColumns = std::array<std::uint64_t, EXTENDED_COLS>;
+
+  /* Where to read one mino's cells from: shifting extended column (pivot column + column)
+   * right by shift gives, at bit (pivot row + MAP_PIVOT_OFFSET), the mino's cell.
+   */
+  struct MinoSource
+  {
+    short column;
+    short shift;
+  };
+
+  using Shape = std::array<MinoSource, 4>;
+
+  Shape build_shape(game::TetriminoType type, short facing)
+  {
+    Shape shape;
+    for (short i=0; i<4; i++)
+    {
+      const game::Point& offset = game::MINO_OFFSETS[(short)type][facing][i];
+      shape[i].column = offset.col - MAP_PIVOT_OFFSET + EXTENDED_COL_OFFSET;
+      shape[i].shift = offset.row - MAP_PIVOT_OFFSET + EXTENDED_ROW_OFFSET;
+    }
+    return shape;
+  }
+
+  /* Widen the playfield's columns, marking walls on either side and the floor below */
+  void extend_columns(const game::Playfield& playfield, ExtendedColumns& columns)
+  {
+    const std::uint64_t floor = ~0ULL << (game::Playfield::HEIGHT + EXTENDED_ROW_OFFSET);
+    columns.fill(~0ULL);
+    for (short col=0; col<game::Playfield::WIDTH; col++)
+      columns[col + EXTENDED_COL_OFFSET] = floor | playfield.columns[col] << EXTENDED_ROW_OFFSET;
+  }
+
+  using BuildFunction = void (*)(game::TetriminoType, const game::Playfield&, CollisionMap&);
+
+  Kernel select_kernel()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return Kernel::AVX2;
+#endif
+    return Kernel::SCALAR;
+  }
+
+  const Kernel selected_kernel = select_kernel();
+  const BuildFunction build_function
+    = selected_kernel == Kernel::AVX2 ? build_map_avx2 : build_map_scalar;
+}
+
+
+/* CollisionMap Class Methods */
+
+bool CollisionMap::collides(const game::Point& pivot, game::TetriminoFacing facing) const
+{
+  short row = pivot.row + MAP_PIVOT_OFFSET;
+  short col = pivot.col + MAP_PIVOT_OFFSET;
+  if (row < 0 || row >= MAP_ROWS || col < 0 || col >= MAP_COLS)
+    return true;
+
+  return columns[(short)facing][col] >> row & 1;
+}
+
+short CollisionMap::landing_row(const game::Point& pivot, game::TetriminoFacing facing) const
+{
+  // Every column collides with the floor before the bottom of the map, so there is always
+  // a set bit below a free pivot
+  std::uint64_t below = columns[(short)facing][pivot.col + MAP_PIVOT_OFFSET]
+    >> (pivot.row + MAP_PIVOT_OFFSET + 1);
+  return pivot.row + __builtin_ctzll(below);
+}
+
+
+/* Free Functions */
+
+void tetris::collision::build_map(game::TetriminoType type,
+                                  const game::Playfield& playfield,
+                                  CollisionMap& map)
+{
+  build_function(type, playfield, map);
+}
+
+void tetris::collision::build_map_scalar(game::TetriminoType type,
+                                         const game::Playfield& playfield,
+                                         CollisionMap& map)
+{
+  ExtendedColumns columns;
+  extend_columns(playfield, columns);
+
+  for (short facing=0; facing<4; facing++)
+  {
+    Shape shape = build_shape(type, facing);
+    for (short col=0; col<MAP_COLS; col++)
+    {
+      std::uint64_t word = 0;
+      for (const MinoSource& mino : shape)
+        word |= columns[col + mino.column] >> mino.shift;
+      map.columns[facing][col] = word;
+    }
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2")))
+void tetris::collision::build_map_avx2(game::TetriminoType type,
+                                       const game::Playfield& playfield,
+                                       CollisionMap& map)
+{
+  ExtendedColumns columns;
+  extend_columns(playfield, columns);
+
+  for (short facing=0; facing<4; facing++)
+  {
+    Shape shape = build_shape(type, facing);
+
+    // Each lane is one pivot column, holding the results for all of its pivot rows
+    for (short col=0; col<MAP_COLS; col+=4)
+    {
+      __m256i words = _mm256_setzero_si256();
+      for (const MinoSource& mino : shape)
+      {
+        __m256i cells = _mm256_loadu_si256((const __m256i*)&columns[col + mino.column]);
+        words = _mm256_or_si256(words, _mm256_srl_epi64(cells, _mm_cvtsi32_si128(mino.shift)));
+      }
+      _mm256_storeu_si256((__m256i*)&map.columns[facing][col], words);
+    }
+  }
+}
+
+#else
+
+void tetris::collision::build_map_avx2(game::TetriminoType type,
+                                       const game::Playfield& playfield,
+                                       CollisionMap& map)
+{
+  build_map_scalar(type, playfield, map);
+}
+
+#endif
+
+Kernel tetris::collision::active_kernel()
+{
+  return selected_kernel;
+}
@@ -0,0 +1,68 @@
+#ifndef TETRIS_COLLISION_HPP
+#define TETRIS_COLLISION_HPP
+
+#include "tetris_game.hpp"
+#include <array>
+#include <cstdint>
+
+namespace tetris
+{
+  namespace collision
+  {
+    /* Pivot positions in a collision map are offset by this much so that they index from
+     * zero. The map covers the same pivots as the move generator's states.
+     */
+    const short MAP_PIVOT_OFFSET = 4;
+    const short MAP_ROWS = 48;
+    const short MAP_COLS = 16;
+
+    /* Enum to identify an implementation of the collision kernel. */
+    enum class Kernel
+    {
+      SCALAR,
+      AVX2,
+    };
+
+    /* Collision results of one tetrimino type at every pivot in every facing.
+     *
+     * Bit (row + MAP_PIVOT_OFFSET) of columns[facing][col + MAP_PIVOT_OFFSET] is set when
+     * the tetrimino with that pivot and facing collides with a wall, the floor or a mino,
+     * exactly as check_collision would report. Keeping each pivot column as one word
+     * turns finding a landing into counting trailing zeros.
+     */
+    struct CollisionMap
+    {
+      std::array<std::array<std::uint64_t, MAP_COLS>, 4> columns;
+
+      /* Check whether a tetrimino at a pivot and facing collides. Pivots outside the map
+       * are reported as colliding.
+       */
+      bool collides(const game::Point& pivot, game::TetriminoFacing facing) const;
+
+      /* Get the pivot row a tetrimino falls to from a free pivot, as get_landing would. */
+      short landing_row(const game::Point& pivot, game::TetriminoFacing facing) const;
+    };
+
+    /* Fill in the collision map of a tetrimino type on a playfield, using the fastest
+     * kernel the CPU supports.
+     *
+     * type[in]: Type of tetrimino to test.
+     * playfield[in]: Playfield to test against.
+     * map[out]: Collision map of every pivot and facing.
+     */
+    void build_map(game::TetriminoType type, const game::Playfield& playfield, CollisionMap& map);
+
+    /* Portable kernel, testing one pivot column at a time. */
+    void build_map_scalar(game::TetriminoType type, const game::Playfield& playfield, CollisionMap& map);
+
+    /* AVX2 kernel, testing four pivot columns per instruction. Only call when the CPU
+     * supports AVX2; build_map checks this.
+     */
+    void build_map_avx2(game::TetriminoType type, const game::Playfield& playfield, CollisionMap& map);
+
+    /* Get the kernel build_map uses, chosen once from the CPU's features. */
+    Kernel active_kernel();
+  }
+}
+
+#endif
@@ -1,199 +1,206 @@
 #include "tetris_control.hpp"
-#include "tetris_game.hpp"
+#include "tetris_bot.hpp"
+#include "tetris_input.hpp"
+#include "tetris_profile.hpp"
+#include "tetris_render.hpp"
+#include "tetris_replay.hpp"
+#include "tetris_save.hpp"
+#include "tetris_session.hpp"
+#include "tetris_timing.hpp"
 #include "tetris_ui.hpp"
+#include <unistd.h>
 #include <chrono>
-#include <thread>
+#include <vector>
 
 
 using namespace tetris;
 using namespace tetris::control;
 
 
-GameResult::GameResult() {}
-
-
-GameResult::GameResult(EndType end_type_init, short end_level_init, long end_score_init)
-  : end_type(end_type_init),
-    end_level(end_level_init),
-    end_score(end_score_init)
-{}
-
-
-GameResult tetris::control::play_game(GameSettings settings)
+session::GameResult tetris::control::play_game(session::GameSettings settings,
+                                               replay::Recorder* recorder,
+                                               bot::Bot* bot,
+                                               profile::Profiler* profiler,
+                                               save::Autosave* autosave,
+                                               const save::SaveState* resume,
+                                               timing::Clock* clock,
+                                               const input::RepeatSettings& repeat_settings)
 {
   // Set up game
-  game::Game game;
-  game.draw_new_tetrimino();
-
-  // Set up placement control
-  bool extended_placement_active = false;
-  std::chrono::steady_clock::time_point extended_placement_start;
-  short extended_placement_moves;
-  bool hard_drop = false;
-
-  // Set up time control
-  std::chrono::steady_clock::time_point last_drop = std::chrono::steady_clock::now();
-  std::chrono::steady_clock::time_point tick_start = std::chrono::steady_clock::now();
-  std::chrono::steady_clock::time_point tick_end = std::chrono::steady_clock::now();
-  bool paused = false;
-
-  ui::redraw_preview(game.bag.tetrimino_queue, settings.preview_size);
-
-  while (!game.is_game_over())
+  session::Session session(settings);
+  session.check_finesse = true;
+  if (resume)
+    save::restore(*resume, session);
+  if (autosave)
+    autosave->save(session);
+
+  // Set up time control; frame n is due to be advanced once n + 1 frames have passed
+  timing::RealClock real_clock;
+  if (!clock)
+    clock = &real_clock;
+  clock->start(session.frame);
+
+  // Draw on a thread of its own, only after something changed; draw everything first
+  render::Renderer renderer(profiler);
+  bool redraw = true;
+
+  // When the changes being drawn were due, for latency profiling
+  profile::Timer timer(profiler);
+  std::chrono::steady_clock::time_point due_time = timer.start;
+
+  input::InputStage input_stage(repeat_settings);
+  std::vector<int> keys;
+  while (!session.is_over())
   {
-    tick_start = std::chrono::steady_clock::now();
-
-    if (paused)
-      ui::redraw_pause_screen();
-    else
-      ui::redraw_playfield(game.playfield, game.active_tetrimino);
-
-    ui::redraw_score(game.score, game.total_rows_cleared, game.level);
+    // Hand the new state to the render thread, without waiting for it to be drawn
+    if (redraw)
+    {
+      timer.restart();
+      render::Snapshot& snapshot = renderer.next_snapshot();
+      render::capture(session, snapshot);
+      snapshot.due_time = due_time;
+      renderer.publish();
+      timer.lap(profile::Phase::SNAPSHOT);
+    }
 
-    // Get input
-    auto result = INPUT_MAP.find(getch());
-    Command command = Command::DO_NOTHING;
-    if (result != INPUT_MAP.end())
-      command = result->second;
+    if (profiler)
+      profiler->dump_if_requested();
 
-    // Quit early if needed
-    if (command == Command::QUIT)
+    // Sleep until a key is pressed or the session has something to do; the bot acts every tick
+    long deadline = bot && !session.paused ? 0 : session.frames_until_deadline();
+    long repeat = session.paused ? session::NO_DEADLINE : input_stage.frames_until_repeat(session.frame);
+    if (repeat != session::NO_DEADLINE && (deadline == session::NO_DEADLINE || repeat < deadline))
+      deadline = repeat;
+    if (deadline == session::NO_DEADLINE)
     {
-      return GameResult(EndType::QUIT, game.level, game.score);
+      timing::wait_for_input();
+      timer.restart();
+      due_time = timer.start;
     }
-    if (command == Command::RESTART)
+    else
     {
-      return GameResult(EndType::RESTART, game.level, game.score);
-    }
+      long wake_frame = session.frame + deadline + 1;
+      clock->sleep_until(wake_frame);
+      std::chrono::steady_clock::time_point wake_time = clock->real_time(wake_frame);
 
-    if (!paused)
-    {
-      if (!settings.gravity
-          || !extended_placement_active
-          || extended_placement_moves <= EXTENDED_PLACEMENT_MAX_MOVES)
+      timer.restart();
+      due_time = timer.start;
+      if (profiler && timer.start >= wake_time)
       {
-        Command command = result->second;
-
-        bool move_executed = false;
-        switch (command)
-        {
-          case Command::DO_NOTHING:
-            break;
-
-          case Command::PAUSE:
-            paused = true;
-            break;
-
-          case Command::SHIFT_LEFT:
-            move_executed = game.active_tetrimino.translate(game::Point(0, -1), game.playfield);
-            break;
-
-          case Command::SHIFT_RIGHT:
-            move_executed = game.active_tetrimino.translate(game::Point(0, 1), game.playfield);
-            break;
-
-          case Command::ROTATE_CCW:
-            move_executed = game.active_tetrimino.rotate_ccw(game.playfield);
-            break;
-
-          case Command::ROTATE_CW:
-            move_executed = game.active_tetrimino.rotate_cw(game.playfield);
-            break;
+        profiler->record(profile::Phase::SLEEP_OVERSHOOT, timer.start - wake_time);
+        due_time = wake_time;
+      }
+    }
 
-          case Command::SOFT_DROP:
-            move_executed = game.active_tetrimino.translate(game::Point(1, 0), game.playfield);
-            if (move_executed)
-              last_drop = tick_start;
-            break;
+    // Read every key press waiting
+    input::read_keys(STDIN_FILENO, keys);
+    timer.lap(profile::Phase::INPUT);
 
-          case Command::HARD_DROP:
-            move_executed = game.active_tetrimino.hard_drop(game.playfield);
-            if (move_executed)
-              hard_drop = true;
-            break;
-        }
+    // Catch up with the frames that have passed
+    short events = session::StepEvent::NONE;
+    long due_frame = clock->frames_passed();
+    if (bot && !session.paused)
+    {
+      while (session.frame < due_frame && !session.is_over())
+      {
+        session::Command command = bot->next_command(session);
+        timer.lap(profile::Phase::BOT);
 
-        if (move_executed && extended_placement_active)
-        {
-          extended_placement_start = tick_start;
-          ++extended_placement_moves;
-        }
+        if (recorder)
+          recorder->record(session.frame, command);
+        events |= session.step(command);
+        timer.lap(profile::Phase::LOGIC);
       }
-
-      // Process drop
-      if (settings.gravity)
+    }
+    else
+    {
+      // Step frame by frame only while a held key is auto-shifting
+      while (session.frame < due_frame
+             && input_stage.auto_shifting
+             && !session.paused
+             && !session.is_over())
       {
-        if (tick_start - last_drop >= game.get_drop_interval())
+        short shifts = input_stage.shifts_due(session.frame);
+        for (short i=0; i<shifts; i++)
         {
-          bool fell = game.active_tetrimino.translate(game::Point(1, 0), game.playfield);
-          if (fell && extended_placement_active)
-            extended_placement_active = false;
-          last_drop = tick_start;
+          // Shifts into a wall change nothing, so they are left out of the replay
+          short shifted = session.apply(input_stage.shift, true);
+          events |= shifted;
+          if (!(shifted & session::StepEvent::MOVED))
+            break;
+          if (recorder)
+            recorder->record(session.frame, input_stage.shift);
         }
+        events |= session.advance();
       }
 
-      // Check for mino landing
-      if (game.active_tetrimino.is_landed(game.playfield))
-      {
-        // Initialize extended placement mode
-        if (!extended_placement_active)
-        {
-          extended_placement_start = tick_start;
-          extended_placement_moves = 0;
-          extended_placement_active = true;
-        }
-
-        // If tetrimino may no longer be manipulated
-        if (hard_drop
-            || (settings.gravity && tick_start > extended_placement_start + EXTENDED_PLACEMENT_MAX_TIME))
-        {
-          game.lock_active_tetrimino();
-          game.clear_rows();
-          game.draw_new_tetrimino();
-          ui::redraw_preview(game.bag.tetrimino_queue, settings.preview_size);
-
-          // Reset placement control
-          extended_placement_active = false;
-          hard_drop = false;
-        }
-      }
+      if (session.frame < due_frame)
+        events |= session.step_frames(due_frame - session.frame);
     }
-    else if (command == Command::PAUSE)
+
+    // Execute every key press waiting during the current frame
+    for (int key : keys)
     {
-      paused = false;
+      if (session.is_over())
+        break;
+
+      session::Command command = input_stage.key_pressed(key, session.frame);
+      if (command == session::Command::DO_NOTHING)
+        continue;
+
+      // Let the bot play, unless the game is being paused, quit or restarted
+      if (bot
+          && command != session::Command::PAUSE
+          && command != session::Command::QUIT
+          && command != session::Command::RESTART)
+        continue;
+
+      if (recorder)
+        recorder->record(session.frame, command);
+      events |= session.apply(command);
     }
+    timer.lap(profile::Phase::LOGIC);
+
+    // Keep the save at the start of the current tetrimino, or at the game over
+    if (autosave
+        && (events & (session::StepEvent::LOCKED | session::StepEvent::HELD)
+            || (session.is_over() && session.end_type == session::EndType::GAME_OVER)))
+      autosave->save(session);
 
-    // Delay until next tick
-    tick_end = std::chrono::steady_clock::now();
-    std::chrono::duration<float> work_time = tick_end - tick_start;
-    if (work_time < TICK_DURATION)
-      std::this_thread::sleep_for(TICK_DURATION - work_time);
+    redraw = events != session::StepEvent::NONE;
   }
 
-  return GameResult(EndType::GAME_OVER, game.level, game.score);
+  renderer.stop();
+  if (recorder)
+    recorder->finish(session.frame);
+
+  return session.result();
 }
 
 bool tetris::control::handle_game_over()
 {
   ui::redraw_game_over_screen();
+  ui::present();
 
   bool rc;
   bool valid_input = false;
   while (!valid_input)
   {
-    auto result = INPUT_MAP.find(getch());
-    Command command = Command::DO_NOTHING;
-    if (result != INPUT_MAP.end())
-      command = result->second;
+    int key = getch();
+    if (key == ERR)
+    {
+      timing::wait_for_input();
+      continue;
+    }
 
-    switch (command)
+    switch (input::command_for_key(key))
     {
-      case Command::RESTART:
+      case session::Command::RESTART:
         rc = true;
         valid_input = true;
         break;
 
-      case Command::QUIT:
+      case session::Command::QUIT:
         rc = false;
         valid_input = true;
         break;
@@ -1,81 +1,45 @@
 #ifndef TETRIS_CONTROL_HPP
 #define TETRIS_CONTROL_HPP
 
-#include "tetris_game.hpp"
-#include <ncurses.h>
-#include <chrono>
+#include "tetris_bot.hpp"
+#include "tetris_input.hpp"
+#include "tetris_profile.hpp"
+#include "tetris_replay.hpp"
+#include "tetris_save.hpp"
+#include "tetris_session.hpp"
+#include "tetris_timing.hpp"
 
 namespace tetris
 {
   namespace control
   {
-    /* Enum to identify user game commands. */
-    enum class Command
-    {
-      DO_NOTHING,
-      PAUSE,
-      QUIT,
-      RESTART,
-      SHIFT_LEFT,
-      SHIFT_RIGHT,
-      ROTATE_CCW,
-      ROTATE_CW,
-      SOFT_DROP,
-      HARD_DROP,
-    };
-
-    /* Enum to identify how a game ended */
-    enum class EndType
-    {
-      GAME_OVER,
-      QUIT,
-      RESTART,
-    };
-
-    /* Struct for game settings */
-    struct GameSettings
-    {
-      bool gravity;
-      short preview_size;
-    };
-
-    /* Struct for all results of a game */
-    struct GameResult
-    {
-      EndType end_type;
-      short end_level;
-      long end_score;
-
-      GameResult();
-
-      GameResult(EndType end_type_init, short end_level_init, long end_score_init);
-    };
-
-    /* Map of (char -> command) */
-    const std::map<int, Command> INPUT_MAP{
-      {ERR, Command::DO_NOTHING},
-      {'p', Command::PAUSE},
-      {'q', Command::QUIT},
-      {'r', Command::RESTART},
-      {'h', Command::SHIFT_LEFT},
-      {'l', Command::SHIFT_RIGHT},
-      {'j', Command::ROTATE_CCW},
-      {'k', Command::ROTATE_CW},
-      {'n', Command::SOFT_DROP},
-      {' ', Command::HARD_DROP},
-    };
-
-    /* Length of each game tick. */
-    const std::chrono::duration<float> TICK_DURATION(1.0/60.0);
-
-    /* Maximum number of moves permitted in extended placement mode. */
-    const short EXTENDED_PLACEMENT_MAX_MOVES = 15;
-
-    /* Extended placement timer duration. */
-    const std::chrono::duration<float> EXTENDED_PLACEMENT_MAX_TIME(0.5);
-
-    /* Play a game of tetris */
-    GameResult play_game(GameSettings settings);
+    /* Play a game of tetris
+     *
+     * Sleeps between key presses, waking early only when gravity or locking is due, so an
+     * idle or paused game uses no CPU. A bot still plays on every tick. Every key waiting
+     * when the game wakes is applied in the same frame.
+     *
+     * settings[in]: Settings for the game.
+     * recorder[out]: If not null, receives every command sent during the game.
+     * bot[in,out]: If not null, plays the game in place of the keyboard. Pause, quit and
+     *              restart keys still work.
+     * profiler[out]: If not null, receives the time spent in each phase of every tick.
+     * autosave[out]: If not null, saved to whenever a tetrimino locks or is held.
+     * resume[in]: If not null, the game continues from this save rather than starting
+     *             afresh; settings must be saved_settings() of it.
+     * clock[in,out]: Time source pacing the game, or null to follow real time. A
+     *                VirtualClock plays as fast as the game can be drawn.
+     * repeat_settings[in]: Delayed auto shift and auto-repeat rate of held shift keys.
+     */
+    session::GameResult play_game(session::GameSettings settings,
+                                  replay::Recorder* recorder=nullptr,
+                                  bot::Bot* bot=nullptr,
+                                  profile::Profiler* profiler=nullptr,
+                                  save::Autosave* autosave=nullptr,
+                                  const save::SaveState* resume=nullptr,
+                                  timing::Clock* clock=nullptr,
+                                  const input::RepeatSettings& repeat_settings
+                                    =input::DEFAULT_REPEAT_SETTINGS);
 
     /* Handle game over */
     bool handle_game_over();
@@ -0,0 +1,218 @@
+#include "tetris_dataset.hpp"
+#include "tetris_game.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+
+using namespace tetris;
+using namespace tetris::dataset;
+
+
+/* Exporter Class Methods */
+
+Exporter::~Exporter()
+{
+  if (base)
+    munmap(base, mapped_size);
+  if (fd >= 0)
+    ::close(fd);
+}
+
+bool Exporter::open(const std::string& path, std::uint64_t capacity_init)
+{
+  capacity = capacity_init;
+  std::array<std::uint64_t, COLUMN_COUNT> offsets = column_offsets(capacity);
+  mapped_size = offsets.back() + capacity * COLUMN_STRIDES.back();
+
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    error = "Could not create dataset file " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  // Extending with ftruncate leaves a sparse file, so unused capacity takes no disk space
+  if (ftruncate(fd, mapped_size) != 0)
+  {
+    error = "Could not resize dataset file " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  void* mapping = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED)
+  {
+    error = "Could not map dataset file " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  base = (std::uint8_t*)mapping;
+
+  Header& file_header = header();
+  std::copy(std::begin(MAGIC), std::end(MAGIC), file_header.magic);
+  file_header.version = FORMAT_VERSION;
+  file_header.record_count = 0;
+  file_header.capacity = capacity;
+  file_header.column_count = COLUMN_COUNT;
+  for (short i=0; i<COLUMN_COUNT; i++)
+  {
+    ColumnInfo& column = file_header.columns[i];
+    std::strncpy(column.name, COLUMN_NAMES[i], sizeof(column.name) - 1);
+    column.stride = COLUMN_STRIDES[i];
+    column.offset = offsets[i];
+  }
+
+  return true;
+}
+
+void Exporter::write(const Record* records, std::size_t count)
+{
+  std::uint64_t first = next_record.fetch_add(count, std::memory_order_relaxed);
+  if (first >= capacity)
+  {
+    dropped += count;
+    return;
+  }
+  if (first + count > capacity)
+  {
+    dropped += first + count - capacity;
+    count = capacity - first;
+  }
+
+  // Fill one column at a time, so each is written sequentially
+  const Header& file_header = header();
+  auto column = [&] (Column id)
+  {
+    const ColumnInfo& info = file_header.columns[(short)id];
+    return base + info.offset + first * info.stride;
+  };
+
+  std::uint8_t* rows = column(Column::ROWS);
+  std::uint8_t* active = column(Column::ACTIVE);
+  std::uint8_t* hold = column(Column::HOLD);
+  std::uint8_t* preview = column(Column::PREVIEW);
+  std::uint8_t* placement = column(Column::PLACEMENT);
+  std::uint8_t* score_delta = column(Column::SCORE_DELTA);
+  std::uint8_t* game = column(Column::GAME);
+  std::uint8_t* piece = column(Column::PIECE);
+
+  for (std::size_t i=0; i<count; i++)
+    std::memcpy(rows + i * sizeof(Record::rows), records[i].rows.data(), sizeof(Record::rows));
+  for (std::size_t i=0; i<count; i++)
+    active[i] = records[i].active;
+  for (std::size_t i=0; i<count; i++)
+    hold[i] = records[i].hold;
+  for (std::size_t i=0; i<count; i++)
+    std::memcpy(preview + i * PREVIEW_LENGTH, records[i].preview.data(), PREVIEW_LENGTH);
+  for (std::size_t i=0; i<count; i++)
+    std::memcpy(placement + i * sizeof(Placement), &records[i].placement, sizeof(Placement));
+  for (std::size_t i=0; i<count; i++)
+    std::memcpy(score_delta + i * sizeof(std::int32_t), &records[i].score_delta, sizeof(std::int32_t));
+  for (std::size_t i=0; i<count; i++)
+    std::memcpy(game + i * sizeof(std::uint32_t), &records[i].game, sizeof(std::uint32_t));
+  for (std::size_t i=0; i<count; i++)
+    std::memcpy(piece + i * sizeof(std::uint32_t), &records[i].piece, sizeof(std::uint32_t));
+}
+
+bool Exporter::finish()
+{
+  if (!base)
+    return false;
+
+  // Move each column down to where it would be in a file sized for the records written.
+  // Columns only ever move towards the start, and in order, so none overwrites another
+  // before it has moved.
+  record_count = std::min<std::uint64_t>(next_record, capacity);
+  std::array<std::uint64_t, COLUMN_COUNT> offsets = column_offsets(record_count);
+  Header& file_header = header();
+  for (short i=0; i<COLUMN_COUNT; i++)
+  {
+    ColumnInfo& column = file_header.columns[i];
+    if (column.offset != offsets[i])
+      std::memmove(base + offsets[i], base + column.offset, record_count * column.stride);
+    column.offset = offsets[i];
+  }
+  file_header.record_count = record_count;
+  file_header.capacity = record_count;
+
+  munmap(base, mapped_size);
+  base = nullptr;
+
+  bool ok = ftruncate(fd, offsets.back() + record_count * COLUMN_STRIDES.back()) == 0;
+  ok &= ::close(fd) == 0;
+  fd = -1;
+  if (!ok)
+    error = std::string("Could not complete dataset file: ") + std::strerror(errno);
+
+  return ok;
+}
+
+Header& Exporter::header()
+{
+  return *(Header*)base;
+}
+
+
+/* Writer Class Methods */
+
+Writer::Writer(Exporter& exporter_init)
+  : exporter(exporter_init)
+{
+  buffer.reserve(WRITER_BLOCK_SIZE);
+}
+
+Writer::~Writer()
+{
+  flush();
+}
+
+void Writer::add(const Record& record)
+{
+  buffer.push_back(record);
+  if ((short)buffer.size() == WRITER_BLOCK_SIZE)
+    flush();
+}
+
+void Writer::flush()
+{
+  if (buffer.empty())
+    return;
+
+  exporter.write(buffer.data(), buffer.size());
+  buffer.clear();
+}
+
+
+/* Free Functions */
+
+std::array<std::uint64_t, COLUMN_COUNT> tetris::dataset::column_offsets(std::uint64_t capacity)
+{
+  std::array<std::uint64_t, COLUMN_COUNT> offsets;
+  std::uint64_t offset = HEADER_SIZE;
+  for (short i=0; i<COLUMN_COUNT; i++)
+  {
+    offsets[i] = offset;
+    offset += capacity * COLUMN_STRIDES[i];
+    offset = (offset + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT;
+  }
+  return offsets;
+}
+
+void tetris::dataset::capture_state(const game::Game& game, Record& record)
+{
+  record.rows = game.playfield.rows;
+  record.active = (std::uint8_t)game.active_tetrimino.type;
+  record.hold = (std::uint8_t)game.held_tetrimino.type;
+
+  const std::deque<game::Tetrimino>& queue = game.bag.tetrimino_queue;
+  for (short i=0; i<PREVIEW_LENGTH; i++)
+    record.preview[i] = i < (short)queue.size() ? (std::uint8_t)queue[i].type : 0;
+}
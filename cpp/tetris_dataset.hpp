@@ -0,0 +1,201 @@
+#ifndef TETRIS_DATASET_HPP
+#define TETRIS_DATASET_HPP
+
+#include "tetris_game.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tetris
+{
+  namespace dataset
+  {
+    /* File signature and format version. */
+    const char MAGIC[4] = {'T', 'T', 'D', 'S'};
+    const std::uint32_t FORMAT_VERSION = 1;
+
+    /* Preview entries kept per record; shorter previews are padded with NONE. */
+    const short PREVIEW_LENGTH = 6;
+
+    /* Enum to identify the columns of a dataset, in file order. */
+    enum class Column
+    {
+      ROWS,        // HEIGHT x RowMask: occupancy mask of each playfield row, bit n for column n
+      ACTIVE,      // uint8: TetriminoType drawn for this decision
+      HOLD,        // uint8: TetriminoType held when it was drawn
+      PREVIEW,     // PREVIEW_LENGTH x uint8: TetriminoTypes following in the bag
+      PLACEMENT,   // Placement: where a tetrimino was locked
+      SCORE_DELTA, // int32: points scored by the lock
+      GAME,        // uint32: index of the game within its batch
+      PIECE,       // uint32: index of the tetrimino within its game
+    };
+
+    const short COLUMN_COUNT = 8;
+
+    /* Names of each column in the file header */
+    const std::array<const char*, COLUMN_COUNT> COLUMN_NAMES{
+      "rows",
+      "active",
+      "hold",
+      "preview",
+      "placement",
+      "score_delta",
+      "game",
+      "piece",
+    };
+
+    /* Where a tetrimino was locked. Type differs from the record's active type when the
+     * held tetrimino was swapped in first.
+     */
+    struct Placement
+    {
+      std::uint8_t type;
+      std::uint8_t facing;
+      std::int8_t row; // Pivot
+      std::int8_t col;
+    };
+
+    /* Bytes taken by one record in each column */
+    const std::array<std::uint32_t, COLUMN_COUNT> COLUMN_STRIDES{
+      game::Playfield::HEIGHT * sizeof(game::Playfield::RowMask),
+      sizeof(std::uint8_t),
+      sizeof(std::uint8_t),
+      PREVIEW_LENGTH * sizeof(std::uint8_t),
+      sizeof(Placement),
+      sizeof(std::int32_t),
+      sizeof(std::uint32_t),
+      sizeof(std::uint32_t),
+    };
+
+    /* One (state, action, reward) sample: the decision taken for one tetrimino. */
+    struct Record
+    {
+      std::array<game::Playfield::RowMask, game::Playfield::HEIGHT> rows;
+      std::uint8_t active;
+      std::uint8_t hold;
+      std::array<std::uint8_t, PREVIEW_LENGTH> preview;
+      Placement placement;
+      std::int32_t score_delta;
+      std::uint32_t game;
+      std::uint32_t piece;
+    };
+
+    /* Location of one column in the file */
+    struct ColumnInfo
+    {
+      char name[24];
+      std::uint32_t stride;
+      std::uint32_t reserved;
+      std::uint64_t offset; // From the start of the file
+    };
+
+    /* Start of a dataset file.
+     *
+     * Each column holds the values of every record back to back, starting at its offset,
+     * so record i of a column is at offset + i * stride. record_count is only final once
+     * the exporter has finished.
+     */
+    struct Header
+    {
+      char magic[4];
+      std::uint32_t version;
+      std::uint64_t record_count;
+      std::uint64_t capacity;     // Records each column has room for
+      std::uint32_t column_count;
+      std::uint32_t reserved;
+      std::array<ColumnInfo, COLUMN_COUNT> columns;
+    };
+
+    /* Bytes before the first column; columns start on cache line boundaries after it */
+    const std::size_t HEADER_SIZE = 4096;
+    const std::size_t COLUMN_ALIGNMENT = 64;
+
+    /* Records a producer collects before reserving space for them. */
+    const short WRITER_BLOCK_SIZE = 256;
+
+    /* Writes records into a memory-mapped dataset file, from any number of threads.
+     *
+     * The file is created at full capacity, as a sparse file, so every column has a fixed
+     * place and the mapping never moves. Producers reserve blocks of record indices with
+     * a single atomic add and then write their columns without any locking. Records
+     * beyond capacity are dropped and counted. finish() packs the columns together and
+     * trims the file to the records actually written.
+     */
+    struct Exporter
+    {
+      int fd = -1;
+      std::uint8_t* base = nullptr;
+      std::size_t mapped_size = 0;
+      std::uint64_t capacity = 0;
+      std::atomic<std::uint64_t> next_record{0};
+      std::atomic<long> dropped{0};
+      std::uint64_t record_count = 0; // Set by finish()
+      std::string error;
+
+      Exporter() = default;
+
+      ~Exporter();
+
+      Exporter(const Exporter&) = delete;
+      Exporter& operator=(const Exporter&) = delete;
+
+      /* Create a dataset file, replacing any existing one.
+       *
+       * path[in]: File to create.
+       * capacity_init[in]: Maximum number of records.
+       *
+       * return: Whether the file is ready; if not, error describes why.
+       */
+      bool open(const std::string& path, std::uint64_t capacity_init);
+
+      /* Copy records into the file. Safe to call concurrently.
+       *
+       * records[in]: Records to write.
+       * count[in]: Number of records.
+       */
+      void write(const Record* records, std::size_t count);
+
+      /* Pack the columns, write the final record count and close the file. No writes
+       * may be in progress.
+       *
+       * return: Whether the file was completed.
+       */
+      bool finish();
+
+      /* Get the header at the start of the mapping. */
+      Header& header();
+    };
+
+    /* Buffers one producer's records and hands them to an exporter in blocks. */
+    struct Writer
+    {
+      Exporter& exporter;
+      std::vector<Record> buffer;
+
+      Writer(Exporter& exporter_init);
+
+      ~Writer();
+
+      /* Add a record, writing the buffer out once it holds a full block. */
+      void add(const Record& record);
+
+      /* Write out any buffered records. */
+      void flush();
+    };
+
+    /* Get the offset of each column in a file with room for capacity records. */
+    std::array<std::uint64_t, COLUMN_COUNT> column_offsets(std::uint64_t capacity);
+
+    /* Fill in the state of a record from the game, as a new tetrimino becomes active.
+     *
+     * game[in]: Game whose active tetrimino was just drawn.
+     * record[out]: Record whose rows, active, hold and preview are set.
+     */
+    void capture_state(const game::Game& game, Record& record);
+  }
+}
+
+#endif
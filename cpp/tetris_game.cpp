@@ -2,16 +2,30 @@
 #include "tetris_log.hpp"
 #include <algorithm>
 #include <array>
-#include <chrono>
-#include <cmath>
 #include <random>
-#include <stdexcept>
 
 
 using namespace tetris;
 using namespace tetris::game;
 
 
+namespace
+{
+  /* Get the hash contribution of a playfield row's cells as if they were at a given row */
+  template<short Width, short Height>
+  std::uint64_t row_key(const BasicPlayfield<Width, Height>& playfield, short row, short position)
+  {
+    std::uint64_t key = 0;
+    for (std::uint32_t mask=playfield.rows[row]; mask; mask&=mask-1)
+    {
+      short col = __builtin_ctz(mask);
+      key ^= CELL_KEYS<Width, Height>[position][col][(short)playfield.grid[row][col]];
+    }
+    return key;
+  }
+}
+
+
 /* Point Class Methods */
 
 Point Point::operator+(const Point& right_op) const
@@ -41,290 +55,356 @@ Point& Point::operator-=(const Point& right_op)
 
 /* Playfield Class Methods */
 
-std::array<TetriminoType, 10>& Playfield::operator[](short index)
+template<short Width, short Height>
+const std::array<TetriminoType, Width>& BasicPlayfield<Width, Height>::operator[](short index) const
 {
   return grid[index];
 }
 
-const std::array<TetriminoType, 10>& Playfield::operator[](short index) const
+template<short Width, short Height>
+TetriminoType BasicPlayfield<Width, Height>::operator[](const Point& point) const
 {
-  return grid[index];
+  return grid[point.row][point.col];
 }
 
-TetriminoType& Playfield::operator[](const Point& point)
+template<short Width, short Height>
+void BasicPlayfield<Width, Height>::set(const Point& point, TetriminoType type)
 {
-  return grid[point.row][point.col];
+  const CellKeyTable<Width, Height>& keys = CELL_KEYS<Width, Height>;
+  hash ^= keys[point.row][point.col][(short)grid[point.row][point.col]]
+    ^ keys[point.row][point.col][(short)type];
+  grid[point.row][point.col] = type;
+  if (type == TetriminoType::NONE)
+  {
+    rows[point.row] &= ~(1U << point.col);
+    columns[point.col] &= ~(1ULL << point.row);
+  }
+  else
+  {
+    rows[point.row] |= 1U << point.col;
+    columns[point.col] |= 1ULL << point.row;
+  }
+  update_column(point.col);
 }
 
-TetriminoType Playfield::operator[](const Point& point) const
+template<short Width, short Height>
+bool BasicPlayfield<Width, Height>::is_row_full(short row) const
 {
-  return grid[point.row][point.col];
+  return rows[row] == FULL_ROW_MASK;
 }
 
+template<short Width, short Height>
+short BasicPlayfield<Width, Height>::clear_full_rows()
+{
+  // Walk upwards, copying each surviving row down to the next free slot from the bottom
+  short write_row = Height - 1;
+  for (short read_row=Height-1; read_row>=0; read_row--)
+  {
+    if (rows[read_row] == FULL_ROW_MASK)
+    {
+      hash ^= row_key(*this, read_row, read_row);
+
+      // Remove the row from each column mask, moving the bits above it down. Rows removed
+      // earlier in the walk have already moved it down to write_row.
+      std::uint64_t below = ~((2ULL << write_row) - 1);
+      std::uint64_t above = (1ULL << write_row) - 1;
+#pragma GCC unroll 32
+      for (std::uint64_t& column : columns)
+        column = (column & below) | ((column & above) << 1);
+      continue;
+    }
 
-/* Tetrimino Class Methods */
+    if (write_row != read_row)
+    {
+      hash ^= row_key(*this, read_row, read_row) ^ row_key(*this, read_row, write_row);
+      rows[write_row] = rows[read_row];
+      grid[write_row] = grid[read_row];
+    }
+    --write_row;
+  }
 
-Tetrimino::Tetrimino(TetriminoType type_init)
-  : type(type_init),
-    facing(TetriminoFacing::NORTH)
-{
-  switch(type)
+  // Everything above the last surviving row is now empty
+  short rows_cleared = write_row + 1;
+  for (short row=write_row; row>=0; row--)
   {
-    case TetriminoType::O:
-      points = {
-        Point(18, 4),
-        Point(18, 5),
-        Point(19, 4),
-        Point(19, 5),
-      };
-      pivot = Point(19, 4);
-      break;
+    rows[row] = 0;
+    grid[row].fill(TetriminoType::NONE);
+  }
 
-    case TetriminoType::I:
-      points = {
-        Point(19, 3),
-        Point(19, 4),
-        Point(19, 5),
-        Point(19, 6),
-      };
-      pivot = Point(19, 4);
-      break;
+  if (rows_cleared)
+  {
+#pragma GCC unroll 32
+    for (short col=0; col<Width; col++)
+      update_column(col);
+  }
 
-    case TetriminoType::T:
-      points = {
-        Point(18, 4),
-        Point(19, 3),
-        Point(19, 4),
-        Point(19, 5),
-      };
-      pivot = Point(19, 4);
-      break;
+  return rows_cleared;
+}
 
-    case TetriminoType::L:
-      points = {
-        Point(18, 5),
-        Point(19, 3),
-        Point(19, 4),
-        Point(19, 5),
-      };
-      pivot = Point(19, 4);
-      break;
+template<short Width, short Height>
+void BasicPlayfield<Width, Height>::update_column(short col)
+{
+  std::uint64_t column = columns[col];
+  heights[col] = column ? Height - __builtin_ctzll(column) : 0;
+  holes[col] = heights[col] - __builtin_popcountll(column);
+}
 
-    case TetriminoType::J:
-      points = {
-        Point(18, 3),
-        Point(19, 3),
-        Point(19, 4),
-        Point(19, 5),
-      };
-      pivot = Point(19, 4);
-      break;
 
-    case TetriminoType::S:
-      points = {
-        Point(18, 4),
-        Point(18, 5),
-        Point(19, 3),
-        Point(19, 4),
-      };
-      pivot = Point(19, 4);
-      break;
+template<short Width, short Height>
+bool BasicPlayfield<Width, Height>::add_garbage(short count, short hole_col)
+{
+  count = std::min(count, Height);
 
-    case TetriminoType::Z:
-      points = {
-        Point(18, 3),
-        Point(18, 4),
-        Point(19, 4),
-        Point(19, 5),
-      };
-      pivot = Point(19, 4);
-      break;
+  bool overflow = false;
+  for (short row=0; row<count; row++)
+    overflow |= rows[row] != 0;
 
-    case TetriminoType::NONE:
-      break;
+  for (short row=0; row<Height-count; row++)
+  {
+    rows[row] = rows[row + count];
+    grid[row] = grid[row + count];
+  }
+
+  RowMask garbage = FULL_ROW_MASK & ~(1U << hole_col);
+  for (short row=Height-count; row<Height; row++)
+  {
+    rows[row] = garbage;
+    grid[row].fill(GARBAGE_TYPE);
+    grid[row][hole_col] = TetriminoType::NONE;
   }
+
+  // Moving a row up shifts it towards bit 0 of each column mask
+  std::uint64_t garbage_bits = count ? ~0ULL << (Height - count) : 0;
+  garbage_bits &= Height == 64 ? ~0ULL : (1ULL << Height) - 1;
+  for (short col=0; col<Width; col++)
+  {
+    columns[col] = count < 64 ? columns[col] >> count : 0;
+    if (col != hole_col)
+      columns[col] |= garbage_bits;
+    update_column(col);
+  }
+
+  // Every cell has moved, so hash the playfield afresh
+  hash = 0;
+  for (short row=0; row<Height; row++)
+    hash ^= row_key(*this, row, row);
+
+  return overflow;
+}
+
+
+/* Tetrimino Class Methods */
+
+Tetrimino::Tetrimino(TetriminoType type_init, const Point& pivot_init)
+  : type(type_init),
+    facing(TetriminoFacing::NORTH)
+{
+  if (type == TetriminoType::NONE)
+    return;
+
+  pivot = pivot_init;
+  const std::array<Point, 4>& offsets = MINO_OFFSETS[(short)type][(short)facing];
+  for (short i=0; i<4; i++)
+    points[i] = pivot + offsets[i];
 }
 
-bool Tetrimino::translate(const Point& delta, const Playfield& playfield)
+template<short Width, short Height>
+bool Tetrimino::translate(const Point& delta, const BasicPlayfield<Width, Height>& playfield)
 {
   Point new_pivot = pivot + delta;
   std::array<Point, 4> new_points = points;
   for (Point& p : new_points)
-  {
     p += delta;
-    if (check_collision(p, playfield) != CollisionResult::NONE)
-      return false;
-  }
+
+  if (check_collision(new_points, playfield) != CollisionResult::NONE)
+    return false;
 
   pivot = new_pivot;
   points = new_points;
   return true;
 }
 
-// TODO refactor rotation functions
-bool Tetrimino::rotate_ccw(const Playfield& playfield)
+template<short Width, short Height>
+bool Tetrimino::rotate(RotationDirection direction, const BasicPlayfield<Width, Height>& playfield)
 {
   if (type == TetriminoType::O)
     return true;
 
   // Determine new facing
-  TetriminoFacing new_facing;
-  switch(facing)
-  {
-    case TetriminoFacing::NORTH:
-      new_facing = TetriminoFacing::WEST;
-      break;
+  short turns = direction == RotationDirection::CW ? 1 : 3;
+  TetriminoFacing new_facing = (TetriminoFacing)(((short)facing + turns) % 4);
 
-    case TetriminoFacing::EAST:
-      new_facing = TetriminoFacing::NORTH;
-      break;
+  TETRIS_LOG_DEBUG("Rotating " << (short)facing << " -> " << (short)new_facing);
 
-    case TetriminoFacing::SOUTH:
-      new_facing = TetriminoFacing::EAST;
-      break;
+  // Try the plain rotation, then each SRS kick, until one is free of collision
+  const std::array<RotationCandidate, ROTATION_CANDIDATE_COUNT>& candidates
+    = ROTATION_TABLE[(short)type][(short)facing][(short)new_facing];
+  for (short i=0; i<ROTATION_CANDIDATE_COUNT; i++)
+  {
+    const RotationCandidate& candidate = candidates[i];
 
-    case TetriminoFacing::WEST:
-      new_facing = TetriminoFacing::SOUTH;
-      break;
-  }
+    std::array<Point, 4> new_points;
+    for (short j=0; j<4; j++)
+      new_points[j] = pivot + candidate.mino_offsets[j];
 
-  // Rotate points
-  std::array<Point, 4> new_points = points;
-  for (Point& p : new_points)
-  {
-    p -= pivot;
-    p = Point(-p.col, p.row);
-    p += pivot;
-  }
+    if (check_collision(new_points, playfield) == CollisionResult::NONE)
+    {
+      if (i > 0)
+        TETRIS_LOG_DEBUG("Using SRS offset " << i << ": " << candidate.pivot_offset);
 
-  // Special handling for I tetrimino
-  if (type == TetriminoType::I)
-  {
-    Point i_offset = Point(1, 0);
-    for (Point& p : new_points)
-      p += i_offset;
+      points = new_points;
+      facing = new_facing;
+      pivot += candidate.pivot_offset;
+      return true;
+    }
   }
 
-  // Process super rotation system
-  Point offset;
-  bool clear = process_srs(type, new_points, playfield, facing, new_facing, offset);
+  TETRIS_LOG_DEBUG("No suitable SRS offset found");
 
-  // Update tetrimino
-  if (clear)
-  {
-    for (Point& p : new_points)
-      p += offset;
+  return false;
+}
 
-    points = new_points;
-    facing = new_facing;
-    pivot += offset;
-  }
+template<short Width, short Height>
+bool Tetrimino::rotate_ccw(const BasicPlayfield<Width, Height>& playfield)
+{
+  return rotate(RotationDirection::CCW, playfield);
+}
 
-  return clear;
+template<short Width, short Height>
+bool Tetrimino::rotate_cw(const BasicPlayfield<Width, Height>& playfield)
+{
+  return rotate(RotationDirection::CW, playfield);
 }
 
-// TODO refactor rotation functions
-bool Tetrimino::rotate_cw(const Playfield& playfield)
+template<short Width, short Height>
+bool Tetrimino::hard_drop(const BasicPlayfield<Width, Height>& playfield)
 {
-  if (type == TetriminoType::O)
-    return true;
+  // The landing position is free of collision by construction
+  Tetrimino landing = get_landing(playfield);
+  pivot = landing.pivot;
+  points = landing.points;
+  return true;
+}
 
-  // Determine new facing
-  TetriminoFacing new_facing;
-  switch(facing)
-  {
-    case TetriminoFacing::NORTH:
-      new_facing = TetriminoFacing::EAST;
-      break;
+template<short Width, short Height>
+bool Tetrimino::is_landed(const BasicPlayfield<Width, Height>& playfield) const
+{
+  std::array<Point, 4> below = points;
+  for (Point& p : below)
+    p += Point(1, 0);
 
-    case TetriminoFacing::EAST:
-      new_facing = TetriminoFacing::SOUTH;
-      break;
+  return check_collision(below, playfield) != CollisionResult::NONE;
+}
 
-    case TetriminoFacing::SOUTH:
-      new_facing = TetriminoFacing::WEST;
-      break;
+template<short Width, short Height>
+Tetrimino Tetrimino::get_landing(const BasicPlayfield<Width, Height>& playfield) const
+{
+  // A tetrimino entirely above the surface falls until a mino meets the top of its column
+  short surface_distance = Height;
+  bool above_surface = true;
+  for (const Point& p : points)
+  {
+    if (p.col < 0 || p.col >= Width)
+      return *this;
 
-    case TetriminoFacing::WEST:
-      new_facing = TetriminoFacing::NORTH;
+    short surface_row = Height - playfield.heights[p.col];
+    if (p.row >= surface_row)
+    {
+      above_surface = false;
       break;
+    }
+    surface_distance = std::min(surface_distance, (short)(surface_row - 1 - p.row));
   }
 
-  // Update points
-  std::array<Point, 4> new_points = points;
-  for (Point& p : new_points)
+  if (above_surface)
   {
-    p -= pivot;
-    p = Point(p.col, -p.row);
-    p += pivot;
+    Tetrimino landing = *this;
+    Point delta(surface_distance, 0);
+    landing.pivot += delta;
+    for (Point& p : landing.points)
+      p += delta;
+
+    return landing;
   }
 
-  // Special handling for I tetrimino
-  if (type == TetriminoType::I)
+  // Otherwise it is tucked under an overhang, so scan down instead. Pack minoes into
+  // per-row masks so each candidate drop is four ANDs
+  short top = points[0].row;
+  short bottom = points[0].row;
+  for (const Point& p : points)
   {
-    Point i_offset = Point(0, 1);
-    for (Point& p : new_points)
-      p += i_offset;
+    top = std::min(top, p.row);
+    bottom = std::max(bottom, p.row);
   }
 
-  // Process super rotation system
-  Point offset;
-  bool clear = process_srs(type, new_points, playfield, facing, new_facing, offset);
+  std::array<typename BasicPlayfield<Width, Height>::RowMask, 4> masks{};
+  for (const Point& p : points)
+  {
+    if (p.col < 0 || p.col >= Width)
+      return *this;
+    masks[p.row - top] |= 1U << p.col;
+  }
 
-  // Update tetrimino
-  if (clear)
+  short distance_to_landing = 0;
+  while (bottom + distance_to_landing < Height - 1)
   {
-    for (Point& p : new_points)
-      p += offset;
+    short next_top = top + distance_to_landing + 1;
+    bool blocked = false;
+    for (short i=0; i<4; i++)
+    {
+      short row = next_top + i;
+      if (row >= 0 && row < Height && (playfield.rows[row] & masks[i]))
+      {
+        blocked = true;
+        break;
+      }
+    }
 
-    points = new_points;
-    facing = new_facing;
-    pivot += offset;
+    if (blocked)
+      break;
+    ++distance_to_landing;
   }
 
-  return clear;
-}
+  Tetrimino landing = *this;
+  Point delta(distance_to_landing, 0);
+  landing.pivot += delta;
+  for (Point& p : landing.points)
+    p += delta;
 
-bool Tetrimino::hard_drop(const Playfield& playfield)
-{
-  short fall_distance = get_landing(playfield).pivot.row - pivot.row;
-  return translate(Point(fall_distance, 0), playfield);
+  return landing;
 }
 
-bool Tetrimino::is_landed(const Playfield& playfield) const
+std::uint64_t Tetrimino::hash() const
 {
-  for (const Point& p : points)
-  {
-    if (check_collision(p + Point(1, 0), playfield))
-      return true;
-  }
-
-  return false;
+  if (type == TetriminoType::NONE)
+    return 0;
+
+  return zobrist_key(KeyTag::TETRIMINO,
+                     (std::uint64_t)type
+                     | (std::uint64_t)facing << 4
+                     | (std::uint64_t)(std::uint16_t)pivot.row << 8
+                     | (std::uint64_t)(std::uint16_t)pivot.col << 24);
 }
 
-Tetrimino Tetrimino::get_landing(const Playfield& playfield) const
-{
-  short distance_to_landing = 41;
 
-  for (short row=0; row<40; row++)
-  {
-    for (const Point& p : points)
-    {
-      if (playfield[row][p.col] != TetriminoType::NONE
-          && (row - p.row - 1 < distance_to_landing) && (row - p.row - 1 >= 0))
-        distance_to_landing = row - p.row - 1;
-    }
-  }
+/* Random Class Methods */
 
-  for (const Point& p : points)
-  {
-    if (39 - p.row < distance_to_landing)
-      distance_to_landing = 39 - p.row;
-  }
+Random::Random(std::uint64_t seed)
+  : state(seed)
+{}
 
-  Tetrimino landing = *this;
-  landing.translate(Point(distance_to_landing, 0), playfield);
-  return landing;
+std::uint64_t Random::next()
+{
+  std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+std::uint32_t Random::below(std::uint32_t bound)
+{
+  // Multiply-shift maps 32 random bits onto [0, bound) without a division
+  return ((next() >> 32) * bound) >> 32;
 }
 
 
@@ -333,7 +413,13 @@ Tetrimino Tetrimino::get_landing(const Playfield& playfield) const
 Bag::Bag()
 {
   std::random_device rd;
-  random_generator = std::default_random_engine(rd());
+  random_generator = Random(((std::uint64_t)rd() << 32) | rd());
+  extend_queue();
+}
+
+Bag::Bag(std::uint64_t seed)
+  : random_generator(seed)
+{
   extend_queue();
 }
 
@@ -359,55 +445,38 @@ void Bag::extend_queue()
     Tetrimino(TetriminoType::Z),
   };
 
-  std::shuffle(tetriminos.begin(), tetriminos.end(), random_generator);
+  // Fisher-Yates shuffle
+  for (short i=6; i>0; i--)
+    std::swap(tetriminos[i], tetriminos[random_generator.below(i + 1)]);
 
   for (Tetrimino t : tetriminos)
     tetrimino_queue.push_back(t);
 }
 
+std::uint64_t Bag::hash() const
+{
+  return zobrist_key(KeyTag::BAG, random_generator.state ^ tetrimino_queue.size());
+}
+
 
 /* Game Class Methods */
 
+Game::Game(std::uint64_t seed)
+  : bag(seed)
+{}
+
 void Game::lock_active_tetrimino()
 {
   for (const Point& p : active_tetrimino.points)
-    playfield[p] = active_tetrimino.type;
+    playfield.set(p, active_tetrimino.type);
+
+  ++total_tetriminoes_locked;
+  hold_available = true;
 }
 
-void Game::clear_rows()
+short Game::clear_rows()
 {
-  short rows_cleared = 0;
-
-  for (short row=39; row>0; row--)
-  {
-    // Check if row is full
-    bool row_full(true);
-    for (short col=0; col<10; col++)
-    {
-      if (playfield[row][col] == TetriminoType::NONE)
-      {
-        row_full = false;
-        break;
-      }
-    }
-
-    // If row is full, clear it and lower upper rows
-    if (row_full)
-    {
-      ++rows_cleared;
-
-      for (short rowc=row; rowc>0; rowc--)
-      {
-        for (short colc=0; colc<10; colc++)
-          playfield[rowc][colc] = playfield[rowc-1][colc];
-      }
-
-      // Since the previously above row has been moved into the current row, that row
-      // would be skipped were row allowed to decrement in the next iteration, so
-      // increment row to counteract.
-      ++row;
-    }
-  }
+  short rows_cleared = playfield.clear_full_rows();
 
   // Add points from row clears
   if (rows_cleared)
@@ -423,6 +492,13 @@ void Game::clear_rows()
       total_rows_cleared_for_next_level += level * 5;
     }
   }
+
+  return rows_cleared;
+}
+
+bool Game::add_garbage(short rows, short hole_col)
+{
+  return playfield.add_garbage(rows, hole_col);
 }
 
 void Game::draw_new_tetrimino()
@@ -430,133 +506,124 @@ void Game::draw_new_tetrimino()
   active_tetrimino = bag.pop();
 }
 
+bool Game::hold_active_tetrimino()
+{
+  if (!hold_available)
+    return false;
+
+  Tetrimino previous(active_tetrimino.type);
+  if (held_tetrimino.type == TetriminoType::NONE)
+    draw_new_tetrimino();
+  else
+    active_tetrimino = Tetrimino(held_tetrimino.type);
+
+  held_tetrimino = previous;
+  hold_available = false;
+  return true;
+}
+
 bool Game::is_game_over()
 {
-  for (const Point& p : active_tetrimino.points)
-    if (check_collision(p, playfield))
-      return true;
+  return check_collision(active_tetrimino.points, playfield) != CollisionResult::NONE;
+}
 
-  return false;
+std::int32_t Game::get_gravity() const
+{
+  return GRAVITY[std::min<short>(std::max<short>(level, 1), MAX_LEVEL) - 1];
 }
 
-std::chrono::duration<float> Game::get_drop_interval()
+std::uint64_t Game::hash() const
 {
-  return std::chrono::duration<float>(pow(0.8 - ((level-1) * 0.007), level-1));
+  std::uint64_t key = playfield.hash
+    ^ active_tetrimino.hash()
+    ^ zobrist_key(KeyTag::HELD, (std::uint64_t)held_tetrimino.type)
+    ^ bag.hash();
+  if (hold_available)
+    key ^= zobrist_key(KeyTag::HOLD_AVAILABLE, 0);
+  return key;
 }
 
 
 /* Free Functions */
 
-short tetris::game::check_collision(const Point& point, const Playfield& playfield)
+template<short Width, short Height>
+short tetris::game::check_collision(const Point& point, const BasicPlayfield<Width, Height>& playfield)
 {
   short result = CollisionResult::NONE;
 
-  if (point.row > 39)
+  if (point.row >= Height)
     result |= CollisionResult::FLOOR;
 
-  if (point.col < 0 || point.col > 9)
+  if (point.col < 0 || point.col >= Width)
     result |= CollisionResult::WALL;
 
-  if (playfield[point.row][point.col] != TetriminoType::NONE)
+  if (result == CollisionResult::NONE
+      && point.row >= 0
+      && (playfield.rows[point.row] & (1U << point.col)))
     result |= CollisionResult::MINO;
 
   return result;
 }
 
-short tetris::game::check_collision(const std::array<Point, 4>& points, const Playfield& playfield)
+template<short Width, short Height>
+short tetris::game::check_collision(const std::array<Point, 4>& points,
+                                    const BasicPlayfield<Width, Height>& playfield)
 {
   short result = CollisionResult::NONE;
-  for (const Point& p : points)
-    result |= check_collision(p, playfield);
 
-  return result;
-}
-
-bool tetris::game::process_srs(TetriminoType type,
-                                const std::array<Point, 4>& points,
-                                const Playfield playfield,
-                                TetriminoFacing facing_before,
-                                TetriminoFacing facing_after,
-                                Point& offset)
-{
-  log::out << "Rotating "
-           << (short)facing_before
-           << " -> "
-           << (short)facing_after
-           << std::endl;
+  short top = points[0].row;
+  for (const Point& p : points)
+    top = std::min(top, p.row);
 
-  if (!check_collision(points, playfield))
+  // Pack in-bounds minoes into one mask per row, relative to the topmost mino
+  std::array<typename BasicPlayfield<Width, Height>::RowMask, 4> masks{};
+  for (const Point& p : points)
   {
-    // New points already free of collision
-    log::out << "SRS not needed" << std::endl;
-    return true;
+    short bounds = CollisionResult::NONE;
+    if (p.row >= Height)
+      bounds |= CollisionResult::FLOOR;
+    if (p.col < 0 || p.col >= Width)
+      bounds |= CollisionResult::WALL;
+
+    if (bounds == CollisionResult::NONE && p.row >= 0)
+      masks[p.row - top] |= 1U << p.col;
+    result |= bounds;
   }
-  else
-  {
-    log::out << "Processing SRS" << std::endl;
 
-    for (const Point& p : points)
-    {
-      log::out << "Point(" << p.row << "," << p.col << ")" << std::endl;
-    }
-    // New points not free of collision, process super rotation system
-    for (short i=0; i<4; i++)
+  for (short i=0; i<4; i++)
+  {
+    short row = top + i;
+    if (row >= 0 && row < Height && (playfield.rows[row] & masks[i]))
     {
-      // Calculate and apply SRS offset
-      offset = calculate_srs_offset(i, type, facing_before, facing_after);
-      log::out << "Checking SRS offset " << i+1 << ": "
-               << offset.row << "," << offset.col
-               << std::endl;
-      std::array<Point, 4> offset_points = points;
-      for (Point& p : offset_points)
-      {
-        p += offset;
-        log::out << "Point(" << p.row << "," << p.col << ")" << std::endl;
-      }
-
-      // Check resulting points for collisions
-      if (!check_collision(offset_points, playfield))
-      {
-        log::out << "Using SRS offset " << i+1 << ": "
-                 << offset.row << "," << offset.col
-                 << std::endl;
-        return true;
-      }
+      result |= CollisionResult::MINO;
+      break;
     }
   }
 
-  log::out << "No suitable SRS offset found" << std::endl;
-
-  return false;
+  return result;
 }
 
-Point tetris::game::get_srs_offset_value(TetriminoType type, TetriminoFacing facing, short point_index)
-{
-  switch(type)
-  {
-    case TetriminoType::I:
-      return I_SRS_OFFSET_VALUES.at(facing)[point_index];
-      break;
-
-    case TetriminoType::T:
-    case TetriminoType::L:
-    case TetriminoType::J:
-    case TetriminoType::S:
-    case TetriminoType::Z:
-      return STANDARD_SRS_OFFSET_VALUES.at(facing)[point_index];
-      break;
 
-    default:
-      throw std::invalid_argument("Invalid tetrimino type for SRS");
-      break;
-  }
-}
-
-Point tetris::game::calculate_srs_offset(short point_index,
-                                          TetriminoType type,
-                                          TetriminoFacing facing_before,
-                                          TetriminoFacing facing_after)
-{
-  return (get_srs_offset_value(type, facing_before, point_index)
-          - get_srs_offset_value(type, facing_after, point_index));
-}
+/* Explicit Instantiations */
+
+// Everything that takes a playfield is compiled once per board size, here, so the
+// templates' definitions can stay out of the header
+#define TETRIS_INSTANTIATE_PLAYFIELD(WIDTH, HEIGHT)                                       \
+  template struct tetris::game::BasicPlayfield<WIDTH, HEIGHT>;                             \
+  template bool Tetrimino::translate(const Point&, const BasicPlayfield<WIDTH, HEIGHT>&);  \
+  template bool Tetrimino::rotate(RotationDirection, const BasicPlayfield<WIDTH, HEIGHT>&); \
+  template bool Tetrimino::rotate_ccw(const BasicPlayfield<WIDTH, HEIGHT>&);               \
+  template bool Tetrimino::rotate_cw(const BasicPlayfield<WIDTH, HEIGHT>&);                \
+  template bool Tetrimino::hard_drop(const BasicPlayfield<WIDTH, HEIGHT>&);                \
+  template bool Tetrimino::is_landed(const BasicPlayfield<WIDTH, HEIGHT>&) const;          \
+  template Tetrimino Tetrimino::get_landing(const BasicPlayfield<WIDTH, HEIGHT>&) const;   \
+  template short tetris::game::check_collision(const Point&,                               \
+                                               const BasicPlayfield<WIDTH, HEIGHT>&);      \
+  template short tetris::game::check_collision(const std::array<Point, 4>&,                \
+                                               const BasicPlayfield<WIDTH, HEIGHT>&);
+
+TETRIS_INSTANTIATE_PLAYFIELD(10, 40)
+TETRIS_INSTANTIATE_PLAYFIELD(16, 40)
+TETRIS_INSTANTIATE_PLAYFIELD(32, 40)
+
+#undef TETRIS_INSTANTIATE_PLAYFIELD
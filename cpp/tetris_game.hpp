@@ -2,11 +2,12 @@
 #define TETRIS_GAME_HPP
 
 #include <array>
-#include <chrono>
+#include <cstdint>
 #include <deque>
 #include <iostream>
 #include <map>
 #include <random>
+#include <type_traits>
 
 namespace tetris
 {
@@ -25,6 +26,9 @@ namespace tetris
       Z,
     };
 
+    /* Type stored in garbage cells, which are drawn the same as O minoes. */
+    const TetriminoType GARBAGE_TYPE = TetriminoType::O;
+
     /* Enum to identify the facing of a tetrimino. */
     enum class TetriminoFacing
     {
@@ -34,6 +38,13 @@ namespace tetris
       WEST,
     };
 
+    /* Enum to identify the direction of a rotation. */
+    enum class RotationDirection
+    {
+      CW,
+      CCW,
+    };
+
     /* Bitmask to identify results of collision tests. */
     namespace CollisionResult
     {
@@ -48,12 +59,12 @@ namespace tetris
     {
       short row, col;
 
-      Point()
+      constexpr Point()
         : row(0),
           col(0)
       {}
 
-      Point(short row_init, short col_init)
+      constexpr Point(short row_init, short col_init)
         : row(row_init),
           col(col_init)
       {}
@@ -72,18 +83,95 @@ namespace tetris
     /* Grid in which the tetriminos fall.
      *
      * Each cell in the grid stores a TetriminoType indicating what type of tetrimino has
-     * been locked into that cell.
+     * been locked into that cell. Alongside the grid, each row keeps a bitboard mask with
+     * bit n set when column n is occupied; collision, landing and row clearing work on
+     * the masks alone, while the grid is only needed to know what colour to draw.
+     *
+     * Each column likewise keeps a mask with bit n set when row n is occupied, from which
+     * its surface height and hole count are kept up to date. These make landing a piece
+     * that is above the surface a few operations, and give bots board features for free.
+     *
+     * The cells are also summarised by a Zobrist hash, the XOR of CELL_KEYS for every
+     * occupied cell, which set() and clear_full_rows() update as they go.
+     *
+     * The dimensions are template parameters, so every bound and mask is a compile-time
+     * constant. Playfield is the standard 10x40 board; wider boards for research modes
+     * are instantiated alongside it in tetris_game.cpp. Rows must fit in 32 bits and
+     * columns in 64.
+     *
+     * Cells must be written through set() so that grid, masks and hash stay in sync.
      */
-    struct Playfield
+    template<short Width, short Height>
+    struct BasicPlayfield
     {
-      std::array<std::array<TetriminoType, 10>, 40> grid{TetriminoType::NONE};
+      static_assert(Width >= 4 && Width <= 32, "Rows are held in 32-bit masks");
+      static_assert(Height >= 4 && Height <= 64, "Columns are held in 64-bit masks");
+
+      using RowMask = std::conditional_t<Width <= 16, std::uint16_t, std::uint32_t>;
 
-      std::array<TetriminoType, 10>& operator[](short index);
-      const std::array<TetriminoType, 10>& operator[](short index) const;
-      TetriminoType& operator[](const Point& point);
+      static constexpr short WIDTH = Width;
+      static constexpr short HEIGHT = Height;
+
+      /* Occupancy mask of a row in which every column is filled. */
+      static constexpr RowMask FULL_ROW_MASK = (RowMask)((1ULL << Width) - 1);
+
+      /* Row in which tetriminoes spawn, the topmost row shown (partly) on screen. */
+      static constexpr short FIRST_VISIBLE_ROW = Height / 2 - 1;
+      static constexpr short VISIBLE_ROWS = Height - FIRST_VISIBLE_ROW;
+
+      /* Pivot of a newly spawned tetrimino. */
+      static constexpr Point SPAWN_POINT = Point(Height / 2 - 1, Width / 2 - 1);
+
+      std::array<std::array<TetriminoType, Width>, Height> grid{TetriminoType::NONE};
+      std::array<RowMask, Height> rows{};
+      std::array<std::uint64_t, Width> columns{};
+      std::array<short, Width> heights{}; // Rows from the floor to the top of the column's surface
+      std::array<short, Width> holes{};   // Empty cells below the column's surface
+      std::uint64_t hash = 0;
+
+      const std::array<TetriminoType, Width>& operator[](short index) const;
       TetriminoType operator[](const Point& point) const;
+
+      /* Write a cell of the playfield.
+       *
+       * point[in]: Cell to write.
+       * type[in]: Type of tetrimino occupying the cell, or NONE to empty it.
+       */
+      void set(const Point& point, TetriminoType type);
+
+      /* Check whether every column of a row is occupied. */
+      bool is_row_full(short row) const;
+
+      /* Remove all full rows, moving the rows above them down in a single pass.
+       *
+       * return: Number of rows removed.
+       */
+      short clear_full_rows();
+
+      /* Recalculate the height and hole count of a column from its mask. */
+      void update_column(short col);
+
+      /* Push rows of garbage in from the bottom, moving every other row up.
+       *
+       * count[in]: Number of rows to add.
+       * hole_col[in]: Column left empty in every garbage row.
+       *
+       * return: Whether any minoes were pushed off the top of the playfield.
+       */
+      bool add_garbage(short count, short hole_col);
     };
 
+    /* The standard board */
+    using Playfield = BasicPlayfield<10, 40>;
+
+    /* Wide boards for research modes */
+    using WidePlayfield16 = BasicPlayfield<16, 40>;
+    using WidePlayfield32 = BasicPlayfield<32, 40>;
+
+    extern template struct BasicPlayfield<10, 40>;
+    extern template struct BasicPlayfield<16, 40>;
+    extern template struct BasicPlayfield<32, 40>;
+
     /* Tetris game piece. */
     struct Tetrimino
     {
@@ -92,7 +180,13 @@ namespace tetris
       std::array<Point, 4> points;
       TetriminoFacing facing;
 
-      Tetrimino(TetriminoType type_init);
+      /* Create a tetrimino in its spawn state, facing north.
+       *
+       * type_init[in]: Type of tetrimino.
+       * pivot_init[in]: Pivot to spawn at, for boards other than the standard one.
+       */
+      Tetrimino(TetriminoType type_init=TetriminoType::NONE,
+                const Point& pivot_init=Playfield::SPAWN_POINT);
 
       /* Translate a tetrimino by delta, if possible.
        *
@@ -103,7 +197,22 @@ namespace tetris
        *
        * return: Whether translation was successful.
        */
-      bool translate(const Point& delta, const Playfield& playfield);
+      template<short Width, short Height>
+      bool translate(const Point& delta, const BasicPlayfield<Width, Height>& playfield);
+
+      /* Rotate a tetrimino in the given direction, if possible.
+       *
+       * Candidate positions are taken from ROTATION_TABLE, trying the unkicked rotation
+       * first and then each SRS kick in order. Does not rotate if every candidate would
+       * result in a collision.
+       *
+       * direction[in]: Direction of rotation.
+       * playfield[in]: Playfield on which rotation will occur.
+       *
+       * return: Whether rotation was successful.
+       */
+      template<short Width, short Height>
+      bool rotate(RotationDirection direction, const BasicPlayfield<Width, Height>& playfield);
 
       /* Rotate a tetrimino counter-clockwise, if possible.
        *
@@ -113,7 +222,8 @@ namespace tetris
        *
        * return: Whether rotation was successful.
        */
-      bool rotate_ccw(const Playfield& playfield);
+      template<short Width, short Height>
+      bool rotate_ccw(const BasicPlayfield<Width, Height>& playfield);
 
       /* Rotate a tetrimino clockwise, if possible.
        *
@@ -123,7 +233,8 @@ namespace tetris
        *
        * return: Whether rotation was successful.
        */
-      bool rotate_cw(const Playfield& playfield);
+      template<short Width, short Height>
+      bool rotate_cw(const BasicPlayfield<Width, Height>& playfield);
 
       /* Drop tetrimino as far as possible.
        *
@@ -131,7 +242,8 @@ namespace tetris
        *
        * return: Whether translation was successful.
        */
-      bool hard_drop(const Playfield& playfield);
+      template<short Width, short Height>
+      bool hard_drop(const BasicPlayfield<Width, Height>& playfield);
 
       /* Check whether tetrimino has fallen as far as it can.
        *
@@ -139,7 +251,8 @@ namespace tetris
        *
        * return: Whether hard drop was successfull.
        */
-      bool is_landed(const Playfield& playfield) const;
+      template<short Width, short Height>
+      bool is_landed(const BasicPlayfield<Width, Height>& playfield) const;
 
       /* Get the eventual landing point for a tetrimino, assuming it falls on its current
        * path.
@@ -148,17 +261,44 @@ namespace tetris
        *
        * return: Tetrimino with the state this one will have once it lands.
        */
-      Tetrimino get_landing(const Playfield& playfield) const;
+      template<short Width, short Height>
+      Tetrimino get_landing(const BasicPlayfield<Width, Height>& playfield) const;
+
+      /* Get a Zobrist key for the tetrimino's type, facing and pivot, or 0 if NONE. */
+      std::uint64_t hash() const;
+    };
+
+    /* Small pseudo-random number generator (SplitMix64).
+     *
+     * Used in place of the standard engines and std::shuffle, whose output is allowed to
+     * differ between standard library implementations, so that a seed always produces the
+     * same game. Replays depend on this.
+     */
+    struct Random
+    {
+      std::uint64_t state;
+
+      Random(std::uint64_t seed=0);
+
+      /* Get the next 64 random bits. */
+      std::uint64_t next();
+
+      /* Get a random integer in [0, bound). */
+      std::uint32_t below(std::uint32_t bound);
     };
 
     /* Semi-random generator for tetriminoes. */
     struct Bag
     {
       std::deque<Tetrimino> tetrimino_queue;
-      std::default_random_engine random_generator;
+      Random random_generator;
 
+      /* Create a bag seeded from the system's random device. */
       Bag();
 
+      /* Create a bag with a fixed seed, producing the same sequence on every run. */
+      Bag(std::uint64_t seed);
+
       /* Remove a tetrimino from the end of the queue and return it.
        *
        * Will automatically extend the queue if not enough tetriminoes are available.
@@ -167,8 +307,34 @@ namespace tetris
 
       /* Extend the queue with another set of seven tetriminoes. */
       void extend_queue();
+
+      /* Get a Zobrist key for the position in the sequence.
+       *
+       * The generator advances once per set of seven, so its state and the queue length
+       * together identify the position; bags with the same seed and the same number of
+       * tetriminoes popped get the same key.
+       */
+      std::uint64_t hash() const;
+    };
+
+    /* Gravity is measured in rows per frame, in fixed point with this as one row. */
+    const std::int32_t GRAVITY_ONE = 1 << 16;
+
+    /* Gravity at each level from 1, in GRAVITY_ONE units.
+     *
+     * Follows the guideline's (0.8 - (level - 1) * 0.007)^(level - 1) seconds per row at
+     * 60 frames per second. Below one row per frame the values are rounded up, so a drop
+     * takes that interval rounded up to whole frames. From level 19 gravity is capped at
+     * 20G, which drops a tetrimino straight to its landing.
+     */
+    const std::array<std::int32_t, 20> GRAVITY{
+      1093, 1366, 1725, 2260, 2979, 4096, 5462, 7282, 10923, 16384,
+      21846, 32768, 32768, 95483, 154742, 256187, 433425, 749597, 1310720, 1310720,
     };
 
+    /* Highest level a game reaches. */
+    const short MAX_LEVEL = GRAVITY.size();
+
     /* Storage and control for game state. */
     struct Game
     {
@@ -176,111 +342,268 @@ namespace tetris
       Bag bag;
       Tetrimino active_tetrimino{TetriminoType::NONE};
       Tetrimino held_tetrimino{TetriminoType::NONE};
+      bool hold_available = true;
       short level = 1;
       short total_rows_cleared = 0;
       short total_rows_cleared_for_next_level = 5 * level;
-      short max_level = 15;
+      short max_level = MAX_LEVEL;
+      long total_tetriminoes_locked = 0;
       long score = 0; // typed for optimism
       // TODO score T-spins
       // TODO score hard drop
       // TODO score soft drop
       // TODO score back-to-back bonus
 
+      Game() = default;
+
+      /* Create a game whose bag is seeded with a fixed seed. */
+      Game(std::uint64_t seed);
+
       /* Write the active tetrimino's minoes to the static playfield */
       void lock_active_tetrimino();
 
-      /* Clear all full rows from the playfield. */
-      void clear_rows();
+      /* Clear all full rows from the playfield, scoring them.
+       *
+       * return: Number of rows cleared.
+       */
+      short clear_rows();
+
+      /* Add garbage rows sent by an opponent.
+       *
+       * rows[in]: Number of garbage rows.
+       * hole_col[in]: Column left empty in every garbage row.
+       *
+       * return: Whether the garbage pushed minoes off the top of the playfield, which
+       *         ends the game.
+       */
+      bool add_garbage(short rows, short hole_col);
 
       /* Pop a new tetrimino from the bag and make it the active tetrimino. */
       void draw_new_tetrimino();
 
+      /* Swap the active tetrimino with the held tetrimino, if holding is available.
+       *
+       * The active tetrimino is held in its spawn state. If nothing was held yet, a new
+       * tetrimino is drawn from the bag. Holding is available again once the next
+       * tetrimino locks.
+       *
+       * return: Whether the tetrimino was held.
+       */
+      bool hold_active_tetrimino();
+
       /* Check for a game over state.
        *
        * return: Whether a game over state has been reached.
        */
       bool is_game_over();
 
-      /* Get the drop interval based on the current level. */
-      std::chrono::duration<float> get_drop_interval();
+      /* Get the gravity of the current level, in GRAVITY_ONE units of rows per frame. */
+      std::int32_t get_gravity() const;
+
+      /* Get a 64-bit Zobrist hash of the position: playfield, active tetrimino, hold and
+       * bag. Score and level are not included.
+       *
+       * Every part is either kept up to date incrementally or hashed from a few fields, so
+       * this never scans the playfield.
+       */
+      std::uint64_t hash() const;
     };
 
     /* Check whether a point collides with any objects on the playfield. */
-    short check_collision(const Point& point, const Playfield& playfield);
-    short check_collision(const std::array<Point, 4>& points, const Playfield& playfield);
+    template<short Width, short Height>
+    short check_collision(const Point& point, const BasicPlayfield<Width, Height>& playfield);
 
-    /* Calculate the SRS offset for a rotation
+    /* Check whether a set of minoes collides with any objects on the playfield.
      *
-     * type[in]: Type of the rotated tetrimino.
-     * points[in]: Location of the tetrimino's minoes.
-     * playfield[in]: Playfield the tetrimino occupies.
-     * facing_before[in]: Tetrimino's facing before the rotation.
-     * facing_after[in]: Tetrimino's facing after the rotation.
-     * offset[out]: Calculated SRS offset.
-     *
-     * return: Whether a usable SRS offset was found for the rotation.
+     * The minoes are packed into one mask per row they cover, and each mask is tested
+     * against the corresponding playfield row with a single AND.
      */
-    bool process_srs(TetriminoType type,
-                     const std::array<Point, 4>& points,
-                     const Playfield playfield,
-                     TetriminoFacing facing_before,
-                     TetriminoFacing facing_after,
-                     Point& offset);
-
-    /* Get a value to use in an SRS offset calculation.
-     *
-     * type[in]: Type of the rotated tetrimino.
-     * facing[in]: Facing of the value to obtain.
-     * point_index[in]: Which SRS point to return (0-3). 0 corresponds to the second SRS
-     *                  point, 3 to the fifth SRS point. The first SRS point is ommitted, as
-     *                  it is always (0, 0).
-     *
-     * return: Relevant SRS offset value.
+    template<short Width, short Height>
+    short check_collision(const std::array<Point, 4>& points, const BasicPlayfield<Width, Height>& playfield);
+
+    /* Multiplied by level to increase score based on number of rows cleared at once */
+    const std::map<short, short> row_clear_multipliers{
+      {1, 100}, {2, 300}, {3, 500}, {4, 800}
+    };
+
+    /* Number of positions tried for each rotation: the unkicked rotation, followed by the
+     * four SRS kicks.
      */
-    Point get_srs_offset_value(TetriminoType type, TetriminoFacing facing, short point_index);
+    const short ROTATION_CANDIDATE_COUNT = 5;
 
-    /* Determine how to translate a tetrimino following a rotation.
-     *
-     * Calculations are made in accordance with the super rotation system.
+    /* Offsets of each tetrimino's minoes from its pivot, indexed by (type, facing).
      *
-     * point_index[in]: Which SRS point to return (0-3). 0 corresponds to the second SRS
-     *                  point, 3 to the fifth SRS point. The first SRS point is ommitted, as
-     *                  it is always (0, 0).
-     * type[in]: Type of the rotated tetrimino.
-     * facing_before[in]: Tetrimino's facing before the rotation.
-     * facing_after[in]: Tetrimino's facing after the rotation.
-     *
-     * return: SRS offset to apply to tetrimino after rotation.
+     * The north facing matches the spawn orientation. Other facings are produced by
+     * rotating clockwise about the pivot; I tetriminoes are additionally shifted one cell
+     * so that they turn about the centre of their 4x4 box, as SRS requires.
      */
-    Point calculate_srs_offset(short point_index,
-                               TetriminoType type,
-                               TetriminoFacing facing_before,
-                               TetriminoFacing facing_after);
+    using MinoOffsetTable = std::array<std::array<std::array<Point, 4>, 4>, 8>;
 
+    constexpr MinoOffsetTable build_mino_offset_table()
+    {
+      MinoOffsetTable table{};
 
-    /* Multiplied by level to increase score based on number of rows cleared at once */
-    const std::map<short, short> row_clear_multipliers{
-      {1, 100}, {2, 300}, {3, 500}, {4, 800}
-    };
+      table[(short)TetriminoType::O][0] = {Point(-1, 0), Point(-1, 1), Point(0, 0), Point(0, 1)};
+      table[(short)TetriminoType::I][0] = {Point(0, -1), Point(0, 0), Point(0, 1), Point(0, 2)};
+      table[(short)TetriminoType::T][0] = {Point(-1, 0), Point(0, -1), Point(0, 0), Point(0, 1)};
+      table[(short)TetriminoType::L][0] = {Point(-1, 1), Point(0, -1), Point(0, 0), Point(0, 1)};
+      table[(short)TetriminoType::J][0] = {Point(-1, -1), Point(0, -1), Point(0, 0), Point(0, 1)};
+      table[(short)TetriminoType::S][0] = {Point(-1, 0), Point(-1, 1), Point(0, -1), Point(0, 0)};
+      table[(short)TetriminoType::Z][0] = {Point(-1, -1), Point(-1, 0), Point(0, 0), Point(0, 1)};
 
-    /* SRS offset values for all tetriminoes other than I and O tetriminoes. */
-    const std::map<TetriminoFacing, std::array<Point, 4>> STANDARD_SRS_OFFSET_VALUES{
-      {TetriminoFacing::NORTH, {Point(0, 0), Point(0, 0), Point(0, 0), Point(0, 0)}},
-      {TetriminoFacing::EAST,  {Point(0, 1), Point(1, 1), Point(-2, 0), Point(-2, 1)}},
-      {TetriminoFacing::SOUTH, {Point(0, 0), Point(0, 0), Point(0, 0), Point(0, 0)}},
-      {TetriminoFacing::WEST,  {Point(0, -1), Point(1, -1), Point(-2, 0), Point(-2, -1)}},
-    };
+      for (short type=0; type<8; type++)
+      {
+        for (short facing=1; facing<4; facing++)
+        {
+          for (short i=0; i<4; i++)
+          {
+            const Point& p = table[type][facing-1][i];
+            if (type == (short)TetriminoType::O)
+              table[type][facing][i] = p;
+            else if (type == (short)TetriminoType::I)
+              table[type][facing][i] = Point(p.col, -p.row + 1);
+            else
+              table[type][facing][i] = Point(p.col, -p.row);
+          }
+        }
+      }
 
-    /* SRS offset values for I tetriminoes. */
-    const std::map<TetriminoFacing, std::array<Point, 4>> I_SRS_OFFSET_VALUES{
-      {TetriminoFacing::NORTH, {Point(0, -1), Point(0, 2), Point(0, -1), Point(0, 2)}},
-      {TetriminoFacing::EAST, {Point(0, 1), Point(0, 1), Point(-1, 1), Point(2, 1)}},
-      {TetriminoFacing::SOUTH, {Point(0, 2), Point(0, -1), Point(1, 2), Point(1, -1)}},
-      {TetriminoFacing::WEST, {Point(0, 0), Point(0, 0), Point(2, 0), Point(-1, 0)}},
-    };
+      return table;
+    }
+
+    constexpr MinoOffsetTable MINO_OFFSETS = build_mino_offset_table();
+
+    /* SRS offset values for all tetriminoes other than I and O tetriminoes, by facing. */
+    constexpr std::array<std::array<Point, 4>, 4> STANDARD_SRS_OFFSET_VALUES{{
+      {Point(0, 0), Point(0, 0), Point(0, 0), Point(0, 0)},
+      {Point(0, 1), Point(1, 1), Point(-2, 0), Point(-2, 1)},
+      {Point(0, 0), Point(0, 0), Point(0, 0), Point(0, 0)},
+      {Point(0, -1), Point(1, -1), Point(-2, 0), Point(-2, -1)},
+    }};
+
+    /* SRS offset values for I tetriminoes, by facing. */
+    constexpr std::array<std::array<Point, 4>, 4> I_SRS_OFFSET_VALUES{{
+      {Point(0, -1), Point(0, 2), Point(0, -1), Point(0, 2)},
+      {Point(0, 1), Point(0, 1), Point(-1, 1), Point(2, 1)},
+      {Point(0, 2), Point(0, -1), Point(1, 2), Point(1, -1)},
+      {Point(0, 0), Point(0, 0), Point(2, 0), Point(-1, 0)},
+    }};
 
     // Note that rotation has no effect on O tetriminoes, and as such they do not need SRS
     // values.
+
+    /* One position to try during a rotation, relative to the pivot before rotating. */
+    struct RotationCandidate
+    {
+      Point pivot_offset;
+      std::array<Point, 4> mino_offsets;
+    };
+
+    /* Rotation candidates, indexed by (type, facing before, facing after, candidate).
+     *
+     * Each candidate already combines the rotated mino offsets with its SRS kick, so a
+     * rotation attempt is one table load per mino followed by one collision check.
+     * Entries for half turns and for O tetriminoes are left empty.
+     */
+    using RotationTable = std::array<
+      std::array<std::array<std::array<RotationCandidate, ROTATION_CANDIDATE_COUNT>, 4>, 4>, 8>;
+
+    constexpr RotationTable build_rotation_table()
+    {
+      RotationTable table{};
+
+      for (short type=0; type<8; type++)
+      {
+        const std::array<std::array<Point, 4>, 4>* srs_values = nullptr;
+        if (type == (short)TetriminoType::I)
+          srs_values = &I_SRS_OFFSET_VALUES;
+        else if (type != (short)TetriminoType::NONE && type != (short)TetriminoType::O)
+          srs_values = &STANDARD_SRS_OFFSET_VALUES;
+        else
+          continue;
+
+        for (short before=0; before<4; before++)
+        {
+          for (short after : {(before + 1) % 4, (before + 3) % 4})
+          {
+            for (short candidate=0; candidate<ROTATION_CANDIDATE_COUNT; candidate++)
+            {
+              Point kick;
+              if (candidate > 0)
+              {
+                const Point& from = (*srs_values)[before][candidate-1];
+                const Point& to = (*srs_values)[after][candidate-1];
+                kick = Point(from.row - to.row, from.col - to.col);
+              }
+
+              RotationCandidate& entry = table[type][before][after][candidate];
+              entry.pivot_offset = kick;
+              for (short i=0; i<4; i++)
+              {
+                const Point& p = MINO_OFFSETS[type][after][i];
+                entry.mino_offsets[i] = Point(p.row + kick.row, p.col + kick.col);
+              }
+            }
+          }
+        }
+      }
+
+      return table;
+    }
+
+    constexpr RotationTable ROTATION_TABLE = build_rotation_table();
+
+    /* Tags keeping the Zobrist keys for different parts of a position independent. */
+    namespace KeyTag
+    {
+      const std::uint64_t CELL           = 1;
+      const std::uint64_t TETRIMINO      = 2;
+      const std::uint64_t HELD           = 3;
+      const std::uint64_t HOLD_AVAILABLE = 4;
+      const std::uint64_t BAG            = 5;
+    }
+
+    /* Scramble the bits of a value (the SplitMix64 finaliser). */
+    constexpr std::uint64_t mix_bits(std::uint64_t value)
+    {
+      value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+      return value ^ (value >> 31);
+    }
+
+    /* Get the Zobrist key for a value of one part of a position.
+     *
+     * tag[in]: KeyTag of the part being hashed.
+     * value[in]: Value of that part.
+     */
+    constexpr std::uint64_t zobrist_key(std::uint64_t tag, std::uint64_t value)
+    {
+      return mix_bits(mix_bits(tag) ^ value);
+    }
+
+    /* Zobrist keys of each playfield cell, indexed by (row, column, tetrimino type).
+     *
+     * Keys for empty cells are 0, so an empty playfield hashes to 0 and only occupied
+     * cells need to be visited.
+     */
+    template<short Width, short Height>
+    using CellKeyTable = std::array<std::array<std::array<std::uint64_t, 8>, Width>, Height>;
+
+    template<short Width, short Height>
+    constexpr CellKeyTable<Width, Height> build_cell_key_table()
+    {
+      CellKeyTable<Width, Height> table{};
+
+      for (short row=0; row<Height; row++)
+        for (short col=0; col<Width; col++)
+          for (short type=1; type<8; type++)
+            table[row][col][type] = zobrist_key(KeyTag::CELL, (row * Width + col) * 8 + type);
+
+      return table;
+    }
+
+    template<short Width, short Height>
+    constexpr CellKeyTable<Width, Height> CELL_KEYS = build_cell_key_table<Width, Height>();
   }
 }
 
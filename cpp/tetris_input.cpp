@@ -0,0 +1,112 @@
+#include "tetris_input.hpp"
+#include "tetris_game.hpp"
+#include "tetris_session.hpp"
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+
+using namespace tetris;
+using namespace tetris::input;
+
+
+/* InputStage Class Methods */
+
+InputStage::InputStage(const RepeatSettings& settings_init)
+  : settings(settings_init)
+{}
+
+session::Command InputStage::key_pressed(int key, long frame)
+{
+  session::Command command = command_for_key(key);
+  if (command != session::Command::SHIFT_LEFT && command != session::Command::SHIFT_RIGHT)
+    return command;
+
+  bool same_key = command == shift;
+  long gap = frame - last_key_frame;
+  last_key_frame = frame;
+
+  // A repeat from the terminal, so the key is being held
+  if (same_key && gap <= TERMINAL_REPEAT_GAP)
+  {
+    repeat_interval = gap;
+    if (!auto_shifting && frame - pressed_frame >= settings.das_frames)
+    {
+      auto_shifting = true;
+      next_shift_frame = frame;
+    }
+    return session::Command::DO_NOTHING;
+  }
+
+  // A new press, unless it may be the terminal's first repeat of the last one
+  if (!same_key || gap > TERMINAL_REPEAT_DELAY)
+    pressed_frame = frame;
+  shift = command;
+  auto_shifting = false;
+  return command;
+}
+
+short InputStage::shifts_due(long frame)
+{
+  if (!auto_shifting)
+    return 0;
+
+  if (frame - last_key_frame > TERMINAL_REPEAT_GAP)
+  {
+    reset();
+    return 0;
+  }
+
+  // Wait for the next repeat before shifting further, in case the key was let go
+  if (frame < next_shift_frame || frame > last_key_frame + repeat_interval)
+    return 0;
+
+  next_shift_frame = frame + std::max(settings.arr_frames, 1L);
+  return settings.arr_frames == 0 ? game::Playfield::WIDTH : 1;
+}
+
+long InputStage::frames_until_repeat(long frame) const
+{
+  if (!auto_shifting)
+    return session::NO_DEADLINE;
+
+  long release_frame = last_key_frame + TERMINAL_REPEAT_GAP + 1;
+  return std::max(0L, std::min(next_shift_frame, release_frame) - frame);
+}
+
+void InputStage::reset()
+{
+  shift = session::Command::DO_NOTHING;
+  auto_shifting = false;
+}
+
+
+/* Free Functions */
+
+session::Command tetris::input::command_for_key(int key)
+{
+  if (key < 0 || key >= KEY_TABLE_SIZE)
+    return session::Command::DO_NOTHING;
+
+  return KEY_COMMANDS[key];
+}
+
+void tetris::input::read_keys(int fd, std::vector<int>& keys)
+{
+  keys.clear();
+
+  std::array<unsigned char, 64> buffer;
+  pollfd fd_poll{fd, POLLIN, 0};
+  while (poll(&fd_poll, 1, 0) > 0 && (fd_poll.revents & POLLIN))
+  {
+    ssize_t length = read(fd, buffer.data(), buffer.size());
+    if (length <= 0)
+      break;
+
+    keys.insert(keys.end(), buffer.begin(), buffer.begin() + length);
+    if (length < (ssize_t)buffer.size())
+      break;
+  }
+}
@@ -0,0 +1,124 @@
+#ifndef TETRIS_INPUT_HPP
+#define TETRIS_INPUT_HPP
+
+#include "tetris_session.hpp"
+#include <array>
+#include <vector>
+
+namespace tetris
+{
+  namespace input
+  {
+    /* Keys covered by the dispatch table; every bound key is 7-bit ASCII. */
+    const short KEY_TABLE_SIZE = 128;
+
+    /* Command bound to each key, indexed by key code. */
+    using KeyTable = std::array<session::Command, KEY_TABLE_SIZE>;
+
+    constexpr KeyTable build_key_table()
+    {
+      KeyTable table{}; // Every key starts as DO_NOTHING, the first command
+
+      table['p'] = session::Command::PAUSE;
+      table['q'] = session::Command::QUIT;
+      table['r'] = session::Command::RESTART;
+      table['h'] = session::Command::SHIFT_LEFT;
+      table['l'] = session::Command::SHIFT_RIGHT;
+      table['j'] = session::Command::ROTATE_CCW;
+      table['k'] = session::Command::ROTATE_CW;
+      table['n'] = session::Command::SOFT_DROP;
+      table[' '] = session::Command::HARD_DROP;
+      table['c'] = session::Command::HOLD;
+
+      return table;
+    }
+
+    constexpr KeyTable KEY_COMMANDS = build_key_table();
+
+    /* Get the command bound to a key, or DO_NOTHING for unbound keys, ncurses' ERR and
+     * special keys beyond the table.
+     */
+    session::Command command_for_key(int key);
+
+    /* Read every key waiting on a terminal without blocking or going through ncurses, so
+     * it is safe while another thread draws.
+     *
+     * fd[in]: Terminal to read, in cbreak mode.
+     * keys[out]: Cleared, then filled with each byte read.
+     */
+    void read_keys(int fd, std::vector<int>& keys);
+
+    /* Longest gap, in frames, between the repeats of a held key. Terminals only send
+     * characters: a held key arrives once, then again at the terminal's repeat rate once
+     * its repeat delay has passed, and releases are never reported. A key counts as held
+     * while its repeats keep arriving this closely, and as released once they stop.
+     */
+    const long TERMINAL_REPEAT_GAP = 4;
+
+    /* Longest delay, in frames, before a terminal starts repeating a held key. A press
+     * this soon after the previous one may be the first repeat, so it does not restart
+     * the delayed auto shift.
+     */
+    const long TERMINAL_REPEAT_DELAY = 45;
+
+    /* Delayed auto shift and auto-repeat rate of held shift keys, in frames */
+    struct RepeatSettings
+    {
+      long das_frames; // Time a shift key must be held before it repeats
+      long arr_frames; // Time between repeats, or 0 to shift straight to the wall
+    };
+
+    const RepeatSettings DEFAULT_REPEAT_SETTINGS{10, 2};
+
+    /* Turns the keys read from a terminal into commands, repeating held shift keys at
+     * the auto-repeat rate rather than the terminal's own.
+     *
+     * The first press of a shift key shifts once. Repeats the terminal sends are
+     * swallowed; once they show the key has been held for das_frames, shifts_due()
+     * supplies a shift every arr_frames until they stop. Shifts wait while a repeat is
+     * overdue, so a released key overshoots by at most one. Since holding is only seen
+     * from the first repeat, auto shift never starts before the terminal's repeat delay,
+     * even when das_frames is shorter.
+     */
+    struct InputStage
+    {
+      RepeatSettings settings;
+      session::Command shift = session::Command::DO_NOTHING; // Shift key being tracked
+      long pressed_frame = 0;    // Frame the tracked key was pressed
+      long last_key_frame = 0;   // Frame the tracked key, or a repeat of it, last arrived
+      long repeat_interval = 0;  // Gap between the terminal's last two repeats of it
+      bool auto_shifting = false;
+      long next_shift_frame = 0;
+
+      InputStage(const RepeatSettings& settings_init);
+
+      /* Get the command to apply for a key read during a frame.
+       *
+       * key[in]: Key code, as returned by getch().
+       * frame[in]: Frame the key is applied in.
+       *
+       * return: Command bound to the key, or DO_NOTHING if it was a repeat taken over by
+       *         auto shift.
+       */
+      session::Command key_pressed(int key, long frame);
+
+      /* Get how many times to apply shift during a frame for auto-repeat, ending auto
+       * shift once the key has been released.
+       *
+       * return: Number of shifts; with an auto-repeat rate of 0 this is enough to reach
+       *         either wall, and the caller stops at the first shift that fails.
+       */
+      short shifts_due(long frame);
+
+      /* Get how many frames can pass before shifts_due() may next return shifts or end
+       * auto shift, or NO_DEADLINE if auto shift is not active.
+       */
+      long frames_until_repeat(long frame) const;
+
+      /* Forget the shift key being tracked. */
+      void reset();
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,304 @@
+#include "tetris_log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+using namespace tetris;
+using namespace tetris::log;
+
+
+std::atomic<bool> log::enabled{false};
+
+
+/* Writer State */
+
+namespace
+{
+  /* How long the writer sleeps when it has not been woken by a new line. */
+  const std::chrono::milliseconds WRITER_IDLE_WAIT(100);
+
+  /* A thread's ring waiting for the writer to take it on. */
+  struct Registration
+  {
+    std::shared_ptr<Ring> ring;
+    Registration* next;
+  };
+
+  /* Shared state of the background writer. */
+  struct Writer
+  {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> pending{false};
+    bool stopping = false;
+    std::thread thread;
+    std::FILE* file = nullptr;
+    std::chrono::steady_clock::time_point start;
+
+    // Rings of threads that started logging since the last drain, pushed without
+    // locking so that a thread's first line never waits for the writer to finish its I/O
+    std::atomic<Registration*> registrations{nullptr};
+    std::atomic<short> next_thread_number{0};
+
+    // Rings of every other thread that has logged; guarded by mutex
+    std::vector<std::shared_ptr<Ring>> rings;
+
+    ~Writer();
+  };
+
+  Writer& writer()
+  {
+    static Writer instance;
+    return instance;
+  }
+
+  /* Owns the calling thread's ring, and marks it closed when the thread exits. */
+  struct RingHandle
+  {
+    std::shared_ptr<Ring> ring;
+
+    ~RingHandle()
+    {
+      if (ring)
+        ring->closed.store(true, std::memory_order_release);
+    }
+  };
+
+  Ring& thread_ring()
+  {
+    thread_local RingHandle handle;
+    if (!handle.ring)
+    {
+      handle.ring = std::make_shared<Ring>();
+      Writer& w = writer();
+      handle.ring->thread_number = w.next_thread_number.fetch_add(1, std::memory_order_relaxed);
+
+      Registration* registration = new Registration{handle.ring, nullptr};
+      registration->next = w.registrations.load(std::memory_order_relaxed);
+      while (!w.registrations.compare_exchange_weak(registration->next, registration,
+                                                    std::memory_order_release,
+                                                    std::memory_order_relaxed))
+        ;
+    }
+    return *handle.ring;
+  }
+
+  LineStream& thread_stream()
+  {
+    thread_local LineStream stream;
+    return stream;
+  }
+
+  const char* level_name(Level level)
+  {
+    switch (level)
+    {
+      case Level::DEBUG:   return "DEBUG";
+      case Level::INFO:    return "INFO";
+      case Level::WARNING: return "WARN";
+      case Level::ERROR:   return "ERROR";
+    }
+    return "";
+  }
+
+  /* Move rings registered since the last call into the writer's list, in the order
+   * their threads started logging. Must hold the writer mutex.
+   */
+  void adopt_registrations(Writer& w)
+  {
+    // The stack holds the newest registration first
+    size_t adopted_from = w.rings.size();
+    Registration* registration = w.registrations.exchange(nullptr, std::memory_order_acquire);
+    while (registration)
+    {
+      Registration* next = registration->next;
+      w.rings.push_back(std::move(registration->ring));
+      delete registration;
+      registration = next;
+    }
+    std::reverse(w.rings.begin() + adopted_from, w.rings.end());
+  }
+
+  /* Write out everything currently queued. Must hold the writer mutex.
+   *
+   * return: Whether any lines were written.
+   */
+  bool drain(Writer& w)
+  {
+    adopt_registrations(w);
+
+    bool wrote = false;
+    for (const std::shared_ptr<Ring>& ring : w.rings)
+    {
+      std::uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+      std::uint32_t head = ring->head.load(std::memory_order_acquire);
+      for (; tail != head; tail++)
+      {
+        const Line& line = ring->lines[tail % RING_SIZE];
+        std::chrono::duration<double> time = line.time - w.start;
+        std::fprintf(w.file, "[%12.6f] %-5s t%hd %.*s\n",
+                     time.count(),
+                     level_name(line.level),
+                     ring->thread_number,
+                     (int)line.length,
+                     line.text.data());
+        wrote = true;
+      }
+      ring->tail.store(tail, std::memory_order_release);
+
+      long dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+      if (dropped)
+      {
+        std::fprintf(w.file, "[%12s] %-5s t%hd %ld lines dropped\n",
+                     "", level_name(Level::WARNING), ring->thread_number, dropped);
+        wrote = true;
+      }
+    }
+
+    // Forget rings of threads that have exited, once they are empty
+    w.rings.erase(
+      std::remove_if(w.rings.begin(), w.rings.end(),
+                     [] (const std::shared_ptr<Ring>& ring)
+                     {
+                       return ring->closed.load(std::memory_order_acquire)
+                         && ring->tail.load(std::memory_order_relaxed)
+                            == ring->head.load(std::memory_order_acquire);
+                     }),
+      w.rings.end());
+
+    return wrote;
+  }
+
+  /* Stop the background thread, write out what is left and close the file. */
+  void shut_down(Writer& w)
+  {
+    {
+      std::lock_guard<std::mutex> lock(w.mutex);
+      w.stopping = true;
+    }
+    w.wake.notify_one();
+    if (w.thread.joinable())
+      w.thread.join();
+
+    std::lock_guard<std::mutex> lock(w.mutex);
+    if (w.file)
+    {
+      drain(w);
+      std::fclose(w.file);
+      w.file = nullptr;
+    }
+  }
+
+  Writer::~Writer()
+  {
+    log::enabled.store(false, std::memory_order_relaxed);
+    shut_down(*this);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    adopt_registrations(*this);
+  }
+
+  void run_writer()
+  {
+    Writer& w = writer();
+    std::unique_lock<std::mutex> lock(w.mutex);
+    while (!w.stopping)
+    {
+      w.wake.wait_for(lock, WRITER_IDLE_WAIT,
+                      [&w] { return w.stopping || w.pending.load(std::memory_order_acquire); });
+      w.pending.store(false, std::memory_order_relaxed);
+      if (drain(w))
+        std::fflush(w.file);
+    }
+  }
+}
+
+
+/* LineBuffer Class Methods */
+
+void LineBuffer::reset()
+{
+  setp(text.data(), text.data() + text.size());
+}
+
+std::uint16_t LineBuffer::length() const
+{
+  return pptr() - pbase();
+}
+
+
+/* LineStream Class Methods */
+
+LineStream::LineStream()
+  : std::ostream(&buffer)
+{
+  buffer.reset();
+}
+
+
+/* Free Functions */
+
+bool tetris::log::open(const std::string& path)
+{
+  close();
+
+  Writer& w = writer();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  w.file = std::fopen(path.c_str(), "w");
+  if (!w.file)
+    return false;
+
+  w.start = std::chrono::steady_clock::now();
+  w.stopping = false;
+  w.thread = std::thread(run_writer);
+  enabled.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+void tetris::log::close()
+{
+  enabled.store(false, std::memory_order_relaxed);
+  shut_down(writer());
+}
+
+LineStream& tetris::log::begin_line()
+{
+  LineStream& stream = thread_stream();
+  stream.buffer.reset();
+  stream.clear();
+  return stream;
+}
+
+void tetris::log::end_line(Level level)
+{
+  const LineStream& stream = thread_stream();
+  Ring& ring = thread_ring();
+
+  std::uint32_t head = ring.head.load(std::memory_order_relaxed);
+  if (head - ring.tail.load(std::memory_order_acquire) >= (std::uint32_t)RING_SIZE)
+  {
+    ring.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  Line& line = ring.lines[head % RING_SIZE];
+  line.time = std::chrono::steady_clock::now();
+  line.level = level;
+  line.length = stream.buffer.length();
+  std::copy_n(stream.buffer.text.data(), line.length, line.text.data());
+  ring.head.store(head + 1, std::memory_order_release);
+
+  // Only wake the writer for the first line since it last looked
+  Writer& w = writer();
+  if (!w.pending.exchange(true, std::memory_order_acq_rel))
+    w.wake.notify_one();
+}
@@ -1,13 +1,137 @@
 #ifndef TETRIS_LOG_HPP
 #define TETRIS_LOG_HPP
 
-#include <fstream>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+/* Minimum severity compiled into the program.
+ *
+ * Log statements below this level are discarded by the compiler, along with the
+ * evaluation of their arguments. Release builds (NDEBUG) keep INFO and above; debug builds
+ * keep everything. Override with -DTETRIS_LOG_LEVEL=n, where n is a log::Level value.
+ */
+#ifndef TETRIS_LOG_LEVEL
+#ifdef NDEBUG
+#define TETRIS_LOG_LEVEL 1
+#else
+#define TETRIS_LOG_LEVEL 0
+#endif
+#endif
+
+/* Write a message to the log, e.g. TETRIS_LOG_INFO("level=" << level).
+ *
+ * The message is formatted on the calling thread into a fixed-size line and handed to the
+ * background writer through a per-thread ring buffer, so logging never waits on the file.
+ * If the ring buffer is full, the line is dropped and counted instead.
+ */
+#define TETRIS_LOG(level, message)                                          \
+  do                                                                        \
+  {                                                                         \
+    if constexpr ((short)(level) >= TETRIS_LOG_LEVEL)                       \
+    {                                                                       \
+      if (tetris::log::is_enabled())                                        \
+      {                                                                     \
+        tetris::log::LineStream& log_stream_ = tetris::log::begin_line();   \
+        log_stream_ << message;                                             \
+        tetris::log::end_line(level);                                       \
+      }                                                                     \
+    }                                                                       \
+  } while (0)
+
+#define TETRIS_LOG_DEBUG(message) TETRIS_LOG(tetris::log::Level::DEBUG, message)
+#define TETRIS_LOG_INFO(message) TETRIS_LOG(tetris::log::Level::INFO, message)
+#define TETRIS_LOG_WARNING(message) TETRIS_LOG(tetris::log::Level::WARNING, message)
+#define TETRIS_LOG_ERROR(message) TETRIS_LOG(tetris::log::Level::ERROR, message)
 
 namespace tetris
 {
   namespace log
   {
-    extern std::ofstream out;
+    /* Enum to identify the severity of a log message. */
+    enum class Level : std::uint8_t
+    {
+      DEBUG,
+      INFO,
+      WARNING,
+      ERROR,
+    };
+
+    /* Maximum length of one log line; longer messages are truncated. */
+    const short LINE_LENGTH = 240;
+
+    /* Number of lines each thread can have waiting for the writer. */
+    const short RING_SIZE = 1024;
+
+    /* One formatted log line. */
+    struct Line
+    {
+      std::chrono::steady_clock::time_point time;
+      Level level;
+      std::uint16_t length;
+      std::array<char, LINE_LENGTH> text;
+    };
+
+    /* Single-producer, single-consumer queue of lines from one thread to the writer. */
+    struct Ring
+    {
+      std::array<Line, RING_SIZE> lines;
+      std::atomic<std::uint32_t> head{0}; // Next slot to write, owned by the producer
+      std::atomic<std::uint32_t> tail{0}; // Next slot to read, owned by the writer
+      std::atomic<long> dropped{0};
+      std::atomic<bool> closed{false};    // Producer thread has exited
+      short thread_number = 0;
+    };
+
+    /* Stream buffer over a fixed character array, which never allocates. */
+    struct LineBuffer : std::streambuf
+    {
+      std::array<char, LINE_LENGTH> text;
+
+      /* Start a new, empty line. */
+      void reset();
+
+      /* Get the number of characters written to the current line. */
+      std::uint16_t length() const;
+    };
+
+    /* Output stream formatting into a LineBuffer. */
+    struct LineStream : std::ostream
+    {
+      LineBuffer buffer;
+
+      LineStream();
+    };
+
+    /* Open a log file and start the background writer.
+     *
+     * path[in]: File to write, truncated if it exists.
+     *
+     * return: Whether the file could be opened.
+     */
+    bool open(const std::string& path);
+
+    /* Write out all pending lines, stop the background writer and close the file. */
+    void close();
+
+    /* Get the calling thread's line stream, emptied. Used by TETRIS_LOG. */
+    LineStream& begin_line();
+
+    /* Queue the calling thread's formatted line for writing. Used by TETRIS_LOG. */
+    void end_line(Level level);
+
+    /* Whether a log file is open; read through is_enabled(). */
+    extern std::atomic<bool> enabled;
+
+    /* Check whether a log file is open. */
+    inline bool is_enabled()
+    {
+      return enabled.load(std::memory_order_relaxed);
+    }
   }
 }
 
@@ -0,0 +1,551 @@
+#include "tetris_movegen.hpp"
+#include "tetris_collision.hpp"
+#include "tetris_game.hpp"
+#include "tetris_session.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+
+using namespace tetris;
+using namespace tetris::movegen;
+
+
+namespace
+{
+  /* Pivot rows inside the map; the rest of each word is outside it and always collides. */
+  const std::uint64_t MAP_ROW_MASK = (1ULL << STATE_ROWS) - 1;
+
+  /* A facing whose minoes cover the same cells as an earlier facing's would with the pivot
+   * moved by an offset, as with the two horizontal facings of an I tetrimino: the state
+   * at pivot p covers the cells of the earlier facing's state at p + offset.
+   */
+  struct DuplicateFacing
+  {
+    bool duplicate;
+    short facing;
+    game::Point offset;
+  };
+
+  using DuplicateTable = std::array<std::array<DuplicateFacing, 4>, 8>;
+
+  constexpr DuplicateTable build_duplicate_table()
+  {
+    DuplicateTable table{};
+
+    for (short type=0; type<8; type++)
+    {
+      for (short later=1; later<4; later++)
+      {
+        const std::array<game::Point, 4>& cells = game::MINO_OFFSETS[type][later];
+        for (short earlier=0; earlier<later && !table[type][later].duplicate; earlier++)
+        {
+          const std::array<game::Point, 4>& other = game::MINO_OFFSETS[type][earlier];
+
+          // Line the two facings up by the top left corners of their bounding boxes
+          short top = cells[0].row, left = cells[0].col;
+          short other_top = other[0].row, other_left = other[0].col;
+          for (short i=1; i<4; i++)
+          {
+            top = std::min(top, cells[i].row);
+            left = std::min(left, cells[i].col);
+            other_top = std::min(other_top, other[i].row);
+            other_left = std::min(other_left, other[i].col);
+          }
+          game::Point offset(top - other_top, left - other_left);
+
+          bool same = true;
+          for (const game::Point& cell : cells)
+          {
+            bool found = false;
+            for (const game::Point& other_cell : other)
+              found |= other_cell.row == cell.row - offset.row
+                       && other_cell.col == cell.col - offset.col;
+            same &= found;
+          }
+
+          if (same)
+            table[type][later] = DuplicateFacing{true, earlier, offset};
+        }
+      }
+    }
+
+    return table;
+  }
+
+  constexpr DuplicateTable DUPLICATE_FACINGS = build_duplicate_table();
+
+  /* Move every state of a column word by a number of rows, dropping those leaving it. */
+  std::uint64_t shift_rows(std::uint64_t word, short rows)
+  {
+    return rows >= 0 ? word << rows : word >> -rows;
+  }
+
+  /* Rotate a column word left. Rows only fill the low STATE_ROWS bits, so rotating by
+   * 64 - n moves every state up n rows, and those wrapping round land outside the map.
+   */
+  std::uint64_t rotate_rows(std::uint64_t word, unsigned rows)
+  {
+    return word << rows | word >> (-rows & 63);
+  }
+
+  /* Get a column word with every free state below a reachable one added, which is where
+   * the reachable states can drop to. Adding the reachable states to the free ones
+   * carries from each through the rest of its run of free rows, clearing them.
+   */
+  std::uint64_t drop(std::uint64_t reach, std::uint64_t free)
+  {
+    return reach | (free & ~(free + reach));
+  }
+
+  /* Get the furthest any SRS kick moves the pivot sideways. */
+  constexpr short get_widest_kick()
+  {
+    short widest = 0;
+    for (const auto& facings : game::ROTATION_TABLE)
+      for (const auto& turns : facings)
+        for (const auto& candidates : turns)
+          for (const game::RotationCandidate& candidate : candidates)
+            widest = std::max<short>(widest, candidate.pivot_offset.col < 0
+                                             ? -candidate.pivot_offset.col
+                                             : candidate.pivot_offset.col);
+    return widest;
+  }
+
+  const short WIDEST_KICK = get_widest_kick();
+
+  /* Check that every state within WIDEST_KICK columns of either side of the map pokes
+   * through a wall, so a shift or kick from any free state lands inside the map.
+   */
+  constexpr bool check_edge_columns_collide()
+  {
+    for (short type=1; type<8; type++)
+    {
+      for (short facing=0; facing<4; facing++)
+      {
+        short left = 0, right = 0;
+        for (const game::Point& offset : game::MINO_OFFSETS[type][facing])
+        {
+          left = std::min(left, offset.col);
+          right = std::max(right, offset.col);
+        }
+
+        short inner_left_pivot = WIDEST_KICK - 1 - STATE_PIVOT_OFFSET;
+        short inner_right_pivot = STATE_COLS - WIDEST_KICK - STATE_PIVOT_OFFSET;
+        if (inner_left_pivot + left >= 0
+            || inner_right_pivot + right < game::Playfield::WIDTH)
+          return false;
+      }
+    }
+
+    for (const auto& facings : DUPLICATE_FACINGS)
+      for (const DuplicateFacing& duplicate : facings)
+        if (duplicate.offset.col < -WIDEST_KICK || duplicate.offset.col > WIDEST_KICK)
+          return false;
+
+    return true;
+  }
+
+  static_assert(check_edge_columns_collide(),
+                "Moves from free states must stay inside the map");
+
+  /* A rotation candidate as a move of whole column words. */
+  struct Kick
+  {
+    short column; // Offset from the old facing's column to the new facing's in a StateBoard
+    short rows;   // Left rotation of the word that moves the pivot down, or up as 64 - rows
+  };
+
+  /* Candidates of each type, facing and turn, where turn 0 is counterclockwise and turn 1
+   * is clockwise.
+   */
+  using KickTable = std::array<std::array<std::array<std::array<Kick,
+                                                                game::ROTATION_CANDIDATE_COUNT>,
+                                                     2>, 4>, 8>;
+
+  constexpr KickTable build_kick_table()
+  {
+    KickTable table{};
+
+    for (short type=0; type<8; type++)
+    {
+      for (short facing=0; facing<4; facing++)
+      {
+        for (short turn=0; turn<2; turn++)
+        {
+          short new_facing = (facing + (turn == 1 ? 1 : 3)) % 4;
+          for (short i=0; i<game::ROTATION_CANDIDATE_COUNT; i++)
+          {
+            const game::Point& offset
+              = game::ROTATION_TABLE[type][facing][new_facing][i].pivot_offset;
+            table[type][facing][turn][i]
+              = Kick{(short)((new_facing - facing) * STATE_COLS + offset.col),
+                     (short)(offset.row & 63)};
+          }
+        }
+      }
+    }
+
+    return table;
+  }
+
+  constexpr KickTable KICKS = build_kick_table();
+
+  /* Check that the first candidate of every turn leaves the pivot where it is. */
+  constexpr bool check_first_candidates_unkicked()
+  {
+    for (const auto& facings : game::ROTATION_TABLE)
+      for (const auto& turns : facings)
+        for (const auto& candidates : turns)
+          if (candidates[0].pivot_offset.row != 0 || candidates[0].pivot_offset.col != 0)
+            return false;
+    return true;
+  }
+
+  static_assert(check_first_candidates_unkicked(),
+                "The flood turns states to the first candidate in place");
+
+  /* States of a column for which the first candidate of a turn is blocked. */
+  struct BlockedTurn
+  {
+    unsigned column; // Word of the StateBoard holding the states
+    unsigned turn;   // 0 for counterclockwise, 1 for clockwise
+    std::uint64_t states;
+  };
+}
+
+
+/* Placement Class Methods */
+
+game::Tetrimino Placement::tetrimino() const
+{
+  game::Tetrimino result(type);
+  result.facing = facing;
+  result.pivot = pivot;
+
+  const std::array<game::Point, 4>& offsets = game::MINO_OFFSETS[(short)type][(short)facing];
+  for (short i=0; i<4; i++)
+    result.points[i] = game::Point(pivot.row + offsets[i].row, pivot.col + offsets[i].col);
+  return result;
+}
+
+
+/* MoveGenerator Class Methods */
+
+MoveGenerator::MoveGenerator()
+{}
+
+short MoveGenerator::generate(const game::Tetrimino& start,
+                              const game::Playfield& playfield,
+                              bool with_paths)
+{
+  placement_count = 0;
+
+  short start_index = state_index(start);
+  if (start_index < 0 || game::check_collision(start.points, playfield) != game::CollisionResult::NONE)
+    return 0;
+
+  collision::build_map(start.type, playfield, collisions);
+  for (short facing=0; facing<4; facing++)
+    for (short col=0; col<STATE_COLS; col++)
+      free[facing * STATE_COLS + col] = ~collisions.columns[facing][col] & MAP_ROW_MASK;
+
+  if (with_paths)
+    search_paths(start.type, start_index);
+  else
+    flood(start.type, start_index);
+
+  collect_placements(start.type, with_paths);
+  return placement_count;
+}
+
+void MoveGenerator::flood(game::TetriminoType type, short start_index)
+{
+  reachable.fill(0);
+  expanded.fill(0);
+
+  // Bit i is set while words[i] of the boards has states yet to expand
+  static_assert(4 * STATE_COLS <= 64, "Pending columns must fit in one word");
+  std::uint64_t pending = 0;
+
+  auto reach = [&] (unsigned column, std::uint64_t states)
+  {
+    pending |= (std::uint64_t)((states & ~reachable[column]) != 0) << column;
+    reachable[column] |= states;
+  };
+
+  reach(start_index % 4 * STATE_COLS + start_index / 4 % STATE_COLS,
+        1ULL << (start_index / 4 / STATE_COLS));
+
+  const std::array<std::array<std::array<Kick, game::ROTATION_CANDIDATE_COUNT>, 2>, 4>& kicks
+    = KICKS[(short)type];
+  bool rotates = type != game::TetriminoType::O;
+
+  // Turns blocked for some states are queued rather than branched on as they come up,
+  // since whether a turn is blocked is too irregular to predict
+  std::array<BlockedTurn, 128> blocked;
+  unsigned blocked_count = 0;
+
+  // Each blocked state turns to the first later candidate that is free, so each
+  // candidate only applies to the states every earlier one failed for. Kicks seldom
+  // reach anything new, and cannot unless some candidate is free and unreached for a
+  // state still turning, which is cheaper to rule out than to follow them in order.
+  auto follow_kicks = [&] ()
+  {
+    for (unsigned i=0; i<blocked_count; i++)
+    {
+      unsigned column = blocked[i].column;
+      const std::array<Kick, game::ROTATION_CANDIDATE_COUNT>& candidates
+        = kicks[column / STATE_COLS][blocked[i].turn];
+      std::uint64_t turning = blocked[i].states;
+
+      std::uint64_t unreached = 0;
+      for (short k=1; k<game::ROTATION_CANDIDATE_COUNT; k++)
+      {
+        unsigned new_column = column + candidates[k].column;
+        unreached |= rotate_rows(turning, candidates[k].rows) & free[new_column]
+                     & ~reachable[new_column];
+      }
+      if (!unreached)
+        continue;
+
+      for (short k=1; k<game::ROTATION_CANDIDATE_COUNT && turning; k++)
+      {
+        unsigned new_column = column + candidates[k].column;
+        std::uint64_t turned = rotate_rows(turning, candidates[k].rows) & free[new_column];
+        reach(new_column, turned);
+        turning &= ~rotate_rows(turned, -candidates[k].rows);
+      }
+    }
+    blocked_count = 0;
+  };
+
+  while (pending)
+  {
+    // The next column is taken before expanding the current one, so that finding it
+    // does not wait on every move the current one makes
+    std::uint64_t next = pending & -pending;
+    pending ^= next;
+    while (next)
+    {
+      unsigned column = __builtin_ctzll(next);
+      next = pending & -pending;
+      pending ^= next;
+
+      // Only free columns are ever reached, and they lie far enough from the edges of
+      // the map that every shift and kick stays inside the same facing
+      std::uint64_t states = drop(reachable[column], free[column]);
+      reachable[column] = states;
+      states &= ~expanded[column];
+      expanded[column] |= states;
+
+      reach(column - 1, states & free[column - 1]);
+      reach(column + 1, states & free[column + 1]);
+
+      // The first candidate of a turn leaves the pivot where it is, in the same column of
+      // the next facing round
+      if (rotates)
+      {
+        unsigned ccw_column = (column + 3 * STATE_COLS) % (4 * STATE_COLS);
+        reach(ccw_column, states & free[ccw_column]);
+        blocked[blocked_count] = BlockedTurn{column, 0, states & ~free[ccw_column]};
+        blocked_count += blocked[blocked_count].states != 0;
+
+        unsigned cw_column = (column + STATE_COLS) % (4 * STATE_COLS);
+        reach(cw_column, states & free[cw_column]);
+        blocked[blocked_count] = BlockedTurn{column, 1, states & ~free[cw_column]};
+        blocked_count += blocked[blocked_count].states != 0;
+
+        if (blocked_count > blocked.size() - 2)
+          follow_kicks();
+      }
+
+      if (!next)
+      {
+        next = pending & -pending;
+        pending ^= next;
+      }
+    }
+
+    follow_kicks();
+  }
+}
+
+void MoveGenerator::search_paths(game::TetriminoType type, short start_index)
+{
+  reachable.fill(0);
+
+  short head = 0;
+  short tail = 0;
+  short current = -1;
+
+  // Queue a state unless it collides or was already reached; returns whether it is free
+  auto reach = [&] (short facing, short row, short col, Move move)
+  {
+    if (row < 0 || row >= STATE_ROWS || col < 0 || col >= STATE_COLS
+        || !(free[facing * STATE_COLS + col] >> row & 1))
+      return false;
+
+    std::uint64_t& reached = reachable[facing * STATE_COLS + col];
+    if (!(reached >> row & 1))
+    {
+      reached |= 1ULL << row;
+      short index = (row * STATE_COLS + col) * 4 + facing;
+      queue[tail++] = index;
+      parent[index] = current;
+      parent_move[index] = move;
+    }
+    return true;
+  };
+
+  reach(start_index % 4, start_index / 4 / STATE_COLS, start_index / 4 % STATE_COLS, Move::DROP);
+
+  while (head < tail)
+  {
+    current = queue[head++];
+    short facing = current % 4;
+    short row = current / 4 / STATE_COLS;
+    short col = current / 4 % STATE_COLS;
+
+    reach(facing, row, col - 1, Move::SHIFT_LEFT);
+    reach(facing, row, col + 1, Move::SHIFT_RIGHT);
+
+    if (type != game::TetriminoType::O)
+    {
+      for (Move move : {Move::ROTATE_CCW, Move::ROTATE_CW})
+      {
+        short new_facing = (facing + (move == Move::ROTATE_CW ? 1 : 3)) % 4;
+        const std::array<game::RotationCandidate, game::ROTATION_CANDIDATE_COUNT>& candidates
+          = game::ROTATION_TABLE[(short)type][facing][new_facing];
+        for (const game::RotationCandidate& candidate : candidates)
+          if (reach(new_facing,
+                    row + candidate.pivot_offset.row,
+                    col + candidate.pivot_offset.col,
+                    move))
+            break;
+      }
+    }
+
+    // A drop may stop at any row on the way down, as a run of soft drops can
+    for (short new_row=row+1; reach(facing, new_row, col, Move::DROP); new_row++)
+      continue;
+  }
+}
+
+void MoveGenerator::collect_placements(game::TetriminoType type, bool with_paths)
+{
+  // Landed states are those with a collision directly below
+  StateBoard landed;
+  for (short column=0; column<4*STATE_COLS; column++)
+    landed[column] = reachable[column] & ~free[column] >> 1;
+
+  // Leave out states covering the same cells as one in an earlier facing; only columns
+  // clear of the edges hold states, and their duplicates are no further than a kick away
+  for (short facing=1; facing<4; facing++)
+  {
+    const DuplicateFacing& duplicate = DUPLICATE_FACINGS[(short)type][facing];
+    if (!duplicate.duplicate)
+      continue;
+
+    for (short col=WIDEST_KICK; col<STATE_COLS - WIDEST_KICK; col++)
+      landed[facing * STATE_COLS + col]
+        &= ~shift_rows(landed[duplicate.facing * STATE_COLS + col + duplicate.offset.col],
+                       -duplicate.offset.row);
+  }
+
+  for (short facing=0; facing<4; facing++)
+  {
+    for (short col=0; col<STATE_COLS; col++)
+    {
+      for (std::uint64_t states=landed[facing * STATE_COLS + col]; states; states&=states-1)
+      {
+        if (placement_count >= MAX_PLACEMENTS)
+          return;
+
+        short row = __builtin_ctzll(states);
+        Placement& placement = placements[placement_count++];
+        placement.type = type;
+        placement.facing = (game::TetriminoFacing)facing;
+        placement.pivot = game::Point(row - STATE_PIVOT_OFFSET, col - STATE_PIVOT_OFFSET);
+
+        placement.path_length = 0;
+        if (with_paths)
+          build_path((row * STATE_COLS + col) * 4 + facing, placement);
+      }
+    }
+  }
+}
+
+void MoveGenerator::build_path(short index, Placement& placement) const
+{
+  // Collect moves from the placement back to the start
+  std::array<short, STATE_COUNT> states;
+  short depth = 0;
+  for (short s=index; parent[s] >= 0; s=parent[s])
+    states[depth++] = s;
+
+  // Replay them forwards as commands, expanding drops into soft drops
+  short length = 0;
+  for (short i=depth-1; i>=0 && length<MAX_PATH_LENGTH; i--)
+  {
+    short s = states[i];
+    switch (parent_move[s])
+    {
+      case Move::SHIFT_LEFT:
+        placement.path[length++] = session::Command::SHIFT_LEFT;
+        break;
+
+      case Move::SHIFT_RIGHT:
+        placement.path[length++] = session::Command::SHIFT_RIGHT;
+        break;
+
+      case Move::ROTATE_CCW:
+        placement.path[length++] = session::Command::ROTATE_CCW;
+        break;
+
+      case Move::ROTATE_CW:
+        placement.path[length++] = session::Command::ROTATE_CW;
+        break;
+
+      case Move::DROP:
+        for (short row=parent[s]/4/STATE_COLS; row<s/4/STATE_COLS && length<MAX_PATH_LENGTH; row++)
+          placement.path[length++] = session::Command::SOFT_DROP;
+        break;
+    }
+  }
+
+  // A hard drop covers any final soft drops, and locks the tetrimino
+  while (length > 0 && placement.path[length-1] == session::Command::SOFT_DROP)
+    --length;
+
+  if (length < MAX_PATH_LENGTH)
+    placement.path[length++] = session::Command::HARD_DROP;
+
+  placement.path_length = length;
+}
+
+
+/* Free Functions */
+
+short tetris::movegen::state_index(const game::Tetrimino& tetrimino)
+{
+  short row = tetrimino.pivot.row + STATE_PIVOT_OFFSET;
+  short col = tetrimino.pivot.col + STATE_PIVOT_OFFSET;
+  if (row < 0 || row >= STATE_ROWS || col < 0 || col >= STATE_COLS)
+    return -1;
+
+  return ((row * STATE_COLS) + col) * 4 + (short)tetrimino.facing;
+}
+
+std::uint64_t tetris::movegen::cell_key(const game::Tetrimino& tetrimino)
+{
+  short top = tetrimino.points[0].row;
+  for (const game::Point& p : tetrimino.points)
+    top = std::min(top, p.row);
+
+  std::uint64_t key = top + STATE_PIVOT_OFFSET;
+  for (const game::Point& p : tetrimino.points)
+    key |= (std::uint64_t)1 << (8 + (p.row - top) * 10 + p.col);
+
+  return key;
+}
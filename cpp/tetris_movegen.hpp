@@ -0,0 +1,146 @@
+#ifndef TETRIS_MOVEGEN_HPP
+#define TETRIS_MOVEGEN_HPP
+
+#include "tetris_collision.hpp"
+#include "tetris_game.hpp"
+#include "tetris_session.hpp"
+#include <array>
+#include <cstdint>
+
+namespace tetris
+{
+  namespace movegen
+  {
+    /* Moves explored by the move generator. */
+    enum class Move : std::uint8_t
+    {
+      SHIFT_LEFT,
+      SHIFT_RIGHT,
+      ROTATE_CCW,
+      ROTATE_CW,
+      DROP, // Fall one or more rows without locking
+    };
+
+    /* Pivot positions are stored offset by this much so that they index from zero. */
+    const short STATE_PIVOT_OFFSET = collision::MAP_PIVOT_OFFSET;
+
+    /* Number of distinct (pivot, facing) states a tetrimino can be in, which is every
+     * state in a collision map.
+     */
+    const short STATE_ROWS = collision::MAP_ROWS;
+    const short STATE_COLS = collision::MAP_COLS;
+    const short STATE_COUNT = STATE_ROWS * STATE_COLS * 4;
+
+    /* Set of (pivot, facing) states, laid out like a collision map with its facings side
+     * by side: bit (row + STATE_PIVOT_OFFSET) of
+     * words[facing * STATE_COLS + col + STATE_PIVOT_OFFSET] stands for the state with that
+     * pivot and facing.
+     */
+    using StateBoard = std::array<std::uint64_t, 4 * STATE_COLS>;
+
+    /* Maximum number of distinct placements returned from one search. */
+    const short MAX_PLACEMENTS = 512;
+
+    /* Maximum number of commands in a placement's input path. */
+    const short MAX_PATH_LENGTH = 96;
+
+    /* Final resting position of a tetrimino, and optionally how to get there.
+     *
+     * The search only records the pivot and facing; the minoes are worked out by
+     * tetrimino(), for just the placements a caller goes on to use.
+     */
+    struct Placement
+    {
+      game::TetriminoType type = game::TetriminoType::NONE;
+      game::TetriminoFacing facing = game::TetriminoFacing::NORTH;
+      game::Point pivot;
+
+      // Commands that move the tetrimino from its start to this placement and lock it,
+      // ending with HARD_DROP. Only filled in when paths are requested.
+      short path_length = 0;
+      std::array<session::Command, MAX_PATH_LENGTH> path;
+
+      /* Get the tetrimino at rest in this placement. */
+      game::Tetrimino tetrimino() const;
+    };
+
+    /* Enumerates every placement reachable from a starting position.
+     *
+     * Follows the real game rules, so shifts, rotations with SRS kicks, soft drops part
+     * way down, tucks under overhangs and spins all behave as Tetrimino::translate,
+     * rotate_cw, rotate_ccw and get_landing would. Every landed state reached is a
+     * candidate placement, and placements that cover the same cells (e.g. the two
+     * horizontal facings of an I tetrimino) are only reported once. Gravity is not
+     * modelled: pieces are assumed to be movable in the air for as long as needed.
+     *
+     * Rather than testing moves against the playfield, the search first builds a
+     * collision map of every state in one batched pass. Without paths it then floods the
+     * map a whole pivot column at a time: each column's reachable rows are one word, so a
+     * drop fills all the free rows below in one addition, and a shift or kick moves every
+     * row of a column at once. Expanding a column shifts and turns all of its rows
+     * together; rows whose turn is blocked are queued, and their kicks are followed in
+     * batches, only where one of them could reach a state not yet reached. Paths need a
+     * breadth-first search over single states instead, in which a drop may stop at any
+     * free row, so each path is the one with the fewest inputs, counting a run of soft
+     * drops as one.
+     *
+     * All working memory is held in the generator and reused across calls, so a
+     * generator should be created once per thread and kept.
+     */
+    struct MoveGenerator
+    {
+      // Search state
+      collision::CollisionMap collisions;
+      StateBoard free;      // States that do not collide
+      StateBoard reachable; // States reached so far
+      StateBoard expanded;  // States whose moves have been followed, when flooding
+
+      // Breadth-first search for paths, indexed by state_index
+      std::array<short, STATE_COUNT> queue;
+      std::array<short, STATE_COUNT> parent;
+      std::array<Move, STATE_COUNT> parent_move;
+
+      // Results of the last search
+      std::array<Placement, MAX_PLACEMENTS> placements;
+      short placement_count = 0;
+
+      MoveGenerator();
+
+      /* Find every placement reachable from a starting position.
+       *
+       * start[in]: Tetrimino in its starting position, usually as spawned.
+       * playfield[in]: Playfield on which the tetrimino moves.
+       * with_paths[in]: Whether to fill in the input path of each placement.
+       *
+       * return: Number of placements found, which are stored in placements.
+       */
+      short generate(const game::Tetrimino& start,
+                     const game::Playfield& playfield,
+                     bool with_paths=false);
+
+      /* Fill reachable with every state reachable from a start state, a pivot column at a
+       * time.
+       */
+      void flood(game::TetriminoType type, short start_index);
+
+      /* Fill reachable with every state reachable from a start state, and parent with the
+       * move that first reached each one.
+       */
+      void search_paths(game::TetriminoType type, short start_index);
+
+      /* Record every landed reachable state as a placement, once per set of cells. */
+      void collect_placements(game::TetriminoType type, bool with_paths);
+
+      /* Fill in the input path of a placement by walking back through the search. */
+      void build_path(short index, Placement& placement) const;
+    };
+
+    /* Get the index of a tetrimino's (pivot, facing) state, or -1 if it is out of range. */
+    short state_index(const game::Tetrimino& tetrimino);
+
+    /* Get a key identifying the set of cells covered by a tetrimino. */
+    std::uint64_t cell_key(const game::Tetrimino& tetrimino);
+  }
+}
+
+#endif
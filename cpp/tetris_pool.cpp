@@ -0,0 +1,145 @@
+#include "tetris_pool.hpp"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+
+using namespace tetris;
+using namespace tetris::pool;
+
+
+/* ThreadPool Class Methods */
+
+ThreadPool::ThreadPool(unsigned thread_count)
+{
+  if (thread_count == 0)
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+  for (unsigned i=0; i<thread_count; i++)
+    ranges.push_back(std::make_unique<WorkRange>());
+
+  for (unsigned i=0; i<thread_count; i++)
+    threads.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(job_mutex);
+    stopping = true;
+  }
+  job_started.notify_all();
+
+  for (std::thread& thread : threads)
+    thread.join();
+}
+
+unsigned ThreadPool::size() const
+{
+  return threads.size();
+}
+
+void ThreadPool::parallel_for(long count, const Task& task_init)
+{
+  if (count <= 0)
+    return;
+
+  // Split the work evenly to begin with
+  long share = count / size();
+  long extra = count % size();
+  long begin = 0;
+  for (unsigned i=0; i<size(); i++)
+  {
+    long end = begin + share + (i < extra ? 1 : 0);
+    std::lock_guard<std::mutex> lock(ranges[i]->mutex);
+    ranges[i]->begin = begin;
+    ranges[i]->end = end;
+    begin = end;
+  }
+
+  std::unique_lock<std::mutex> lock(job_mutex);
+  task = &task_init;
+  workers_busy = size();
+  ++job_generation;
+  job_started.notify_all();
+  job_finished.wait(lock, [this] { return workers_busy == 0; });
+  task = nullptr;
+}
+
+void ThreadPool::work(unsigned worker)
+{
+  long seen_generation = 0;
+  while (true)
+  {
+    const Task* current_task;
+    {
+      std::unique_lock<std::mutex> lock(job_mutex);
+      job_started.wait(lock, [&] { return stopping || job_generation != seen_generation; });
+      if (stopping)
+        return;
+      seen_generation = job_generation;
+      current_task = task;
+    }
+
+    long index;
+    while (take(worker, index))
+      (*current_task)(index, worker);
+
+    std::lock_guard<std::mutex> lock(job_mutex);
+    if (--workers_busy == 0)
+      job_finished.notify_one();
+  }
+}
+
+bool ThreadPool::take(unsigned worker, long& index)
+{
+  // Take from the front of own range
+  {
+    WorkRange& own = *ranges[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (own.begin < own.end)
+    {
+      index = own.begin++;
+      return true;
+    }
+  }
+
+  // Own range is empty, so steal the back half of the largest other range
+  while (true)
+  {
+    unsigned victim = worker;
+    long victim_size = 0;
+    for (unsigned i=0; i<size(); i++)
+    {
+      long remaining = ranges[i]->end - ranges[i]->begin; // racy estimate, rechecked below
+      if (i != worker && remaining > victim_size)
+      {
+        victim = i;
+        victim_size = remaining;
+      }
+    }
+
+    if (victim == worker)
+      return false;
+
+    long stolen_begin, stolen_end;
+    {
+      WorkRange& other = *ranges[victim];
+      std::lock_guard<std::mutex> lock(other.mutex);
+      if (other.begin >= other.end)
+        continue;
+
+      long mid = other.begin + (other.end - other.begin) / 2;
+      stolen_begin = mid;
+      stolen_end = other.end;
+      other.end = mid;
+    }
+
+    WorkRange& own = *ranges[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    index = stolen_begin;
+    own.begin = stolen_begin + 1;
+    own.end = stolen_end;
+    return true;
+  }
+}
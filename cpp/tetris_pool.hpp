@@ -0,0 +1,90 @@
+#ifndef TETRIS_POOL_HPP
+#define TETRIS_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tetris
+{
+  namespace pool
+  {
+    /* Task run by a pool: called with the index of one work item and the index of the
+     * worker thread running it.
+     */
+    using Task = std::function<void(long index, unsigned worker)>;
+
+    /* Range of work item indices owned by one worker.
+     *
+     * Bounds are only modified with the mutex held, but may be read without it to pick a
+     * worker to steal from.
+     */
+    struct WorkRange
+    {
+      std::mutex mutex;
+      std::atomic<long> begin{0};
+      std::atomic<long> end{0};
+    };
+
+    /* Fixed set of worker threads that share work by stealing.
+     *
+     * Each call to parallel_for splits its index range evenly between the workers. A
+     * worker takes items from the front of its own range, and once that is exhausted it
+     * steals the back half of the largest remaining range of another worker, so uneven
+     * item costs are balanced without a shared queue.
+     */
+    struct ThreadPool
+    {
+      std::vector<std::thread> threads;
+      std::vector<std::unique_ptr<WorkRange>> ranges;
+
+      // Job control
+      std::mutex job_mutex;
+      std::condition_variable job_started;
+      std::condition_variable job_finished;
+      const Task* task = nullptr;
+      long job_generation = 0;
+      unsigned workers_busy = 0;
+      bool stopping = false;
+
+      /* Start a pool.
+       *
+       * thread_count[in]: Number of worker threads, or 0 to use one per hardware thread.
+       */
+      ThreadPool(unsigned thread_count=0);
+
+      ~ThreadPool();
+
+      ThreadPool(const ThreadPool&) = delete;
+      ThreadPool& operator=(const ThreadPool&) = delete;
+
+      /* Get the number of worker threads. */
+      unsigned size() const;
+
+      /* Run a task for every index in [0, count), returning once all have completed.
+       *
+       * count[in]: Number of work items.
+       * task[in]: Task to run for each item. Called concurrently from all workers.
+       */
+      void parallel_for(long count, const Task& task);
+
+      /* Main loop of each worker thread. */
+      void work(unsigned worker);
+
+      /* Take the next item for a worker, stealing from other workers if needed.
+       *
+       * worker[in]: Worker requesting an item.
+       * index[out]: Item taken.
+       *
+       * return: Whether an item was available.
+       */
+      bool take(unsigned worker, long& index);
+    };
+  }
+}
+
+#endif
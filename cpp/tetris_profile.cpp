@@ -0,0 +1,181 @@
+#include "tetris_profile.hpp"
+#include "tetris_session.hpp"
+#include <signal.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+
+using namespace tetris;
+using namespace tetris::profile;
+
+
+namespace
+{
+  volatile std::sig_atomic_t dump_requested = 0;
+
+  void handle_dump_signal(int)
+  {
+    dump_requested = 1;
+  }
+
+  /* Add to a counter that only the calling thread writes, without a locked instruction */
+  template<typename T>
+  void add_single_writer(std::atomic<T>& counter, T value)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+}
+
+
+/* Histogram Class Methods */
+
+void Histogram::record(std::uint64_t value)
+{
+  add_single_writer(counts[bucket_index(value)], 1L);
+  add_single_writer(count, 1L);
+  add_single_writer(total, value);
+  if (value > max.load(std::memory_order_relaxed))
+    max.store(value, std::memory_order_relaxed);
+}
+
+std::uint64_t Histogram::percentile(double fraction) const
+{
+  long total_count = count.load(std::memory_order_relaxed);
+  if (total_count == 0)
+    return 0;
+
+  long target = std::max(1L, (long)(fraction * total_count + 0.5));
+  long seen = 0;
+  for (short i=0; i<HISTOGRAM_BUCKETS; i++)
+  {
+    seen += counts[i];
+    if (seen >= target)
+      return std::min(bucket_value(i), max.load(std::memory_order_relaxed));
+  }
+  return max.load(std::memory_order_relaxed);
+}
+
+
+/* Profiler Class Methods */
+
+Profiler::Profiler(const std::string& output_path_init)
+  : output_path(output_path_init)
+{}
+
+void Profiler::record(Phase phase, std::chrono::steady_clock::duration duration)
+{
+  std::chrono::nanoseconds nanoseconds = duration;
+  histograms[(short)phase].record(std::max(0L, (long)nanoseconds.count()));
+}
+
+void Profiler::record_tick(std::chrono::steady_clock::duration latency)
+{
+  add_single_writer(ticks, 1L);
+  if (latency > session::TICK_DURATION)
+    add_single_writer(missed_deadlines, 1L);
+  record(Phase::LATENCY, latency);
+}
+
+bool Profiler::dump() const
+{
+  std::FILE* file = std::fopen(output_path.c_str(), "w");
+  if (!file)
+    return false;
+
+  long ticks_drawn = ticks.load(std::memory_order_relaxed);
+  long missed = missed_deadlines.load(std::memory_order_relaxed);
+  std::fprintf(file, "Ticks drawn: %ld  Missed deadlines: %ld (%.2f%%, over %.1f ms)\n\n",
+               ticks_drawn,
+               missed,
+               ticks_drawn ? 100.0 * missed / ticks_drawn : 0.0,
+               session::TICK_DURATION.count() * 1000);
+  std::fprintf(file, "%-18s %10s %10s %10s %10s %10s  (microseconds)\n",
+               "phase", "count", "mean", "p50", "p99", "max");
+  for (short i=0; i<PHASE_COUNT; i++)
+  {
+    const Histogram& histogram = histograms[i];
+    long count = histogram.count.load(std::memory_order_relaxed);
+    std::fprintf(file, "%-18s %10ld %10.1f %10.1f %10.1f %10.1f\n",
+                 PHASE_NAMES[i],
+                 count,
+                 count ? histogram.total.load(std::memory_order_relaxed) / 1000.0 / count : 0.0,
+                 histogram.percentile(0.5) / 1000.0,
+                 histogram.percentile(0.99) / 1000.0,
+                 histogram.max.load(std::memory_order_relaxed) / 1000.0);
+  }
+
+  return std::fclose(file) == 0;
+}
+
+bool Profiler::dump_if_requested() const
+{
+  if (!dump_requested)
+    return false;
+
+  dump_requested = 0;
+  return dump();
+}
+
+
+/* Timer Class Methods */
+
+Timer::Timer(Profiler* profiler_init)
+  : profiler(profiler_init)
+{
+  restart();
+}
+
+void Timer::restart()
+{
+  if (profiler)
+    start = std::chrono::steady_clock::now();
+}
+
+void Timer::lap(Phase phase)
+{
+  if (!profiler)
+    return;
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  profiler->record(phase, now - start);
+  start = now;
+}
+
+
+/* Free Functions */
+
+short tetris::profile::bucket_index(std::uint64_t value)
+{
+  value = std::min<std::uint64_t>(value, (1ULL << HISTOGRAM_MAX_BITS) - 1);
+  if (value < (std::uint64_t)SUB_BUCKET_COUNT)
+    return value;
+
+  // Keep the top SUB_BUCKET_BITS bits; the shift selects the power of two
+  short shift = (63 - __builtin_clzll(value)) - (SUB_BUCKET_BITS - 1);
+  short half = SUB_BUCKET_COUNT / 2;
+  return SUB_BUCKET_COUNT + (shift - 1) * half + ((value >> shift) - half);
+}
+
+std::uint64_t tetris::profile::bucket_value(short index)
+{
+  if (index < SUB_BUCKET_COUNT)
+    return index;
+
+  short half = SUB_BUCKET_COUNT / 2;
+  short shift = (index - SUB_BUCKET_COUNT) / half + 1;
+  std::uint64_t sub_bucket = (index - SUB_BUCKET_COUNT) % half + half;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+void tetris::profile::dump_on_signal(int signal_number)
+{
+  struct sigaction action{};
+  action.sa_handler = handle_dump_signal;
+  sigemptyset(&action.sa_mask);
+  sigaction(signal_number, &action, nullptr);
+}
@@ -0,0 +1,152 @@
+#ifndef TETRIS_PROFILE_HPP
+#define TETRIS_PROFILE_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace tetris
+{
+  namespace profile
+  {
+    /* Enum to identify the phases of a tick that are timed. */
+    enum class Phase
+    {
+      INPUT,            // Reading key presses
+      LOGIC,            // Advancing the session and executing commands
+      BOT,              // Bot choosing its commands
+      SNAPSHOT,         // Copying the session for the render thread
+      REDRAW_PLAYFIELD, // Drawing the playfield, or the pause screen in its place
+      REDRAW_SCORE,
+      REDRAW_PREVIEW,
+      REDRAW_HOLD,
+      PRESENT,          // Writing the drawn windows to the terminal
+      SLEEP_OVERSHOOT,  // Waking later than requested
+      LATENCY,          // From a frame being due, or a key arriving, to it being on screen
+    };
+
+    const short PHASE_COUNT = 11;
+
+    /* Names of each phase in reports */
+    const std::array<const char*, PHASE_COUNT> PHASE_NAMES{
+      "input",
+      "logic",
+      "bot",
+      "snapshot",
+      "redraw_playfield",
+      "redraw_score",
+      "redraw_preview",
+      "redraw_hold",
+      "present",
+      "sleep_overshoot",
+      "latency",
+    };
+
+    /* Significant bits kept of each value, giving a relative error below 1% */
+    const short SUB_BUCKET_BITS = 7;
+    const short SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+
+    /* Values are clamped to below 2^HISTOGRAM_MAX_BITS ns, a little over a minute */
+    const short HISTOGRAM_MAX_BITS = 36;
+    const short HISTOGRAM_BUCKETS
+      = SUB_BUCKET_COUNT + (HISTOGRAM_MAX_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT / 2;
+
+    /* Log-linear histogram of durations in nanoseconds, in the style of HdrHistogram.
+     *
+     * Values below SUB_BUCKET_COUNT are counted exactly; above that, each power of two is
+     * split into SUB_BUCKET_COUNT / 2 equal buckets. Recording is a few bit operations and
+     * never allocates.
+     *
+     * Only one thread may record into a histogram, but any thread may read it meanwhile:
+     * the counters are atomics updated with plain loads and stores, which cost no more
+     * than ordinary increments.
+     */
+    struct Histogram
+    {
+      std::array<std::atomic<long>, HISTOGRAM_BUCKETS> counts{};
+      std::atomic<long> count{0};
+      std::atomic<std::uint64_t> total{0};
+      std::atomic<std::uint64_t> max{0};
+
+      /* Count one value. */
+      void record(std::uint64_t value);
+
+      /* Get the value below which the given fraction of recorded values lie.
+       *
+       * fraction[in]: Fraction of values, between 0 and 1.
+       *
+       * return: Highest value in the bucket holding that fraction, or 0 if empty.
+       */
+      std::uint64_t percentile(double fraction) const;
+    };
+
+    /* Per-phase tick timings, accumulated over every game of a run.
+     *
+     * The logic and render threads record different phases, and only the render thread
+     * counts ticks, so each counter has a single writer and a report can be written from
+     * either thread at any time.
+     */
+    struct Profiler
+    {
+      std::string output_path;
+      std::array<Histogram, PHASE_COUNT> histograms;
+      std::atomic<long> ticks{0};
+      std::atomic<long> missed_deadlines{0};
+
+      Profiler(const std::string& output_path_init);
+
+      /* Count the time spent in a phase. */
+      void record(Phase phase, std::chrono::steady_clock::duration duration);
+
+      /* Count one drawn tick, given the time from its frame being due to it being on screen.
+       *
+       * Ticks taking longer than TICK_DURATION count as missed deadlines.
+       */
+      void record_tick(std::chrono::steady_clock::duration latency);
+
+      /* Write a report of all phases to output_path, replacing its contents.
+       *
+       * return: Whether the report could be written.
+       */
+      bool dump() const;
+
+      /* Dump if the signal set up by dump_on_signal() has arrived since the last call.
+       *
+       * return: Whether a report was written.
+       */
+      bool dump_if_requested() const;
+    };
+
+    /* Times consecutive phases for a profiler; does nothing when the profiler is null. */
+    struct Timer
+    {
+      Profiler* profiler;
+      std::chrono::steady_clock::time_point start;
+
+      Timer(Profiler* profiler_init);
+
+      /* Start timing a new phase from now. */
+      void restart();
+
+      /* Record the time since the last lap or restart under a phase, and restart. */
+      void lap(Phase phase);
+    };
+
+    /* Get the bucket of a Histogram that counts a value. */
+    short bucket_index(std::uint64_t value);
+
+    /* Get the highest value counted by a bucket of a Histogram. */
+    std::uint64_t bucket_value(short index);
+
+    /* Make a signal request a dump from Profiler::dump_if_requested().
+     *
+     * The handler does not restart interrupted system calls, so a loop sleeping in poll()
+     * wakes up to notice the request.
+     */
+    void dump_on_signal(int signal_number);
+  }
+}
+
+#endif
@@ -0,0 +1,154 @@
+#include "tetris_render.hpp"
+#include "tetris_game.hpp"
+#include "tetris_profile.hpp"
+#include "tetris_session.hpp"
+#include "tetris_stats.hpp"
+#include "tetris_ui.hpp"
+#include <semaphore.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+
+using namespace tetris;
+using namespace tetris::render;
+
+
+/* SnapshotBuffer Class Methods */
+
+Snapshot& SnapshotBuffer::back_slot()
+{
+  return slots[back];
+}
+
+void SnapshotBuffer::publish()
+{
+  back = middle.exchange(back | FRESH_SLOT, std::memory_order_acq_rel) & ~FRESH_SLOT;
+}
+
+bool SnapshotBuffer::take()
+{
+  if (!(middle.load(std::memory_order_relaxed) & FRESH_SLOT))
+    return false;
+
+  front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH_SLOT;
+  return true;
+}
+
+const Snapshot& SnapshotBuffer::front_slot() const
+{
+  return slots[front];
+}
+
+
+/* Renderer Class Methods */
+
+Renderer::Renderer(profile::Profiler* profiler_init)
+  : profiler(profiler_init)
+{
+  drawn_preview.fill(game::TetriminoType::NONE);
+  sem_init(&published, 0, 0);
+  thread = std::thread(&Renderer::run, this);
+}
+
+Renderer::~Renderer()
+{
+  stop();
+  sem_destroy(&published);
+}
+
+Snapshot& Renderer::next_snapshot()
+{
+  return buffer.back_slot();
+}
+
+void Renderer::publish()
+{
+  buffer.publish();
+  sem_post(&published);
+}
+
+void Renderer::stop()
+{
+  if (!thread.joinable())
+    return;
+
+  stopping.store(true, std::memory_order_release);
+  sem_post(&published);
+  thread.join();
+}
+
+void Renderer::run()
+{
+  while (true)
+  {
+    while (sem_wait(&published) != 0)
+      continue;
+
+    if (buffer.take())
+      draw(buffer.front_slot());
+
+    if (stopping.load(std::memory_order_acquire))
+      break;
+  }
+}
+
+void Renderer::draw(const Snapshot& snapshot)
+{
+  profile::Timer timer(profiler);
+
+  if (!drawn || snapshot.preview != drawn_preview)
+  {
+    ui::redraw_preview(snapshot.preview, snapshot.preview_size);
+    drawn_preview = snapshot.preview;
+    timer.lap(profile::Phase::REDRAW_PREVIEW);
+  }
+  if (!drawn || snapshot.held_type != drawn_held_type)
+  {
+    ui::redraw_hold(snapshot.held_type);
+    drawn_held_type = snapshot.held_type;
+    timer.lap(profile::Phase::REDRAW_HOLD);
+  }
+
+  if (!snapshot.paused)
+    ui::redraw_frame(snapshot.frame);
+  else if (!drawn || !drawn_paused)
+    ui::redraw_pause_screen();
+  drawn_paused = snapshot.paused;
+  timer.lap(profile::Phase::REDRAW_PLAYFIELD);
+
+  ui::redraw_score(snapshot.score, snapshot.rows, snapshot.level, snapshot.stats);
+  timer.lap(profile::Phase::REDRAW_SCORE);
+
+  ui::present();
+  timer.lap(profile::Phase::PRESENT);
+
+  if (profiler)
+    profiler->record_tick(timer.start - snapshot.due_time);
+  drawn = true;
+}
+
+
+/* Free Functions */
+
+void tetris::render::capture(const session::Session& session, Snapshot& snapshot)
+{
+  const game::Game& game = session.game;
+
+  snapshot.paused = session.paused;
+  if (!session.paused)
+    ui::build_frame(game.playfield, game.active_tetrimino, snapshot.frame);
+
+  snapshot.score = game.score;
+  snapshot.rows = game.total_rows_cleared;
+  snapshot.level = game.level;
+  snapshot.stats = session.stats_summary();
+
+  snapshot.preview_size = std::min<short>(session.settings.preview_size, ui::MAX_PREVIEW_SIZE);
+  snapshot.preview.fill(game::TetriminoType::NONE);
+  for (short i=0; i<snapshot.preview_size; i++)
+    snapshot.preview[i] = game.bag.tetrimino_queue[i].type;
+
+  snapshot.held_type = game.held_tetrimino.type;
+}
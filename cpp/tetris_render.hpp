@@ -0,0 +1,124 @@
+#ifndef TETRIS_RENDER_HPP
+#define TETRIS_RENDER_HPP
+
+#include "tetris_game.hpp"
+#include "tetris_profile.hpp"
+#include "tetris_session.hpp"
+#include "tetris_stats.hpp"
+#include "tetris_ui.hpp"
+#include <semaphore.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace tetris
+{
+  namespace render
+  {
+    /* Everything drawn for one tick, copied out of the session so that the logic thread
+     * can carry on while it is drawn.
+     */
+    struct Snapshot
+    {
+      ui::Frame frame;
+      bool paused;
+      long score;
+      short rows;
+      short level;
+      stats::Summary stats;
+      ui::Preview preview; // Entries past preview_size are TetriminoType::NONE
+      short preview_size;
+      game::TetriminoType held_type;
+      std::chrono::steady_clock::time_point due_time; // When the changes shown were due
+    };
+
+    /* Fill in a snapshot of a session's current state, apart from its due time. */
+    void capture(const session::Session& session, Snapshot& snapshot);
+
+    /* Set in SnapshotBuffer::middle while the middle slot holds a snapshot not yet taken */
+    const std::uint8_t FRESH_SLOT = 4;
+
+    /* Lock-free triple buffer passing snapshots from one writer thread to one reader.
+     *
+     * The writer fills the back slot and swaps it with the middle one; the reader swaps
+     * its front slot with the middle one when a fresh snapshot is there. Neither ever
+     * waits for the other, and the reader always gets the latest snapshot, skipping any
+     * it was too slow to draw.
+     */
+    struct SnapshotBuffer
+    {
+      std::array<Snapshot, 3> slots;
+      std::uint8_t back = 0;  // Writer only
+      std::uint8_t front = 2; // Reader only
+      std::atomic<std::uint8_t> middle{1};
+
+      /* Get the slot to fill with the next snapshot. Writer only. */
+      Snapshot& back_slot();
+
+      /* Hand the filled back slot to the reader. Writer only. */
+      void publish();
+
+      /* Move the latest published snapshot to the front slot. Reader only.
+       *
+       * return: Whether a snapshot was published since the last call.
+       */
+      bool take();
+
+      /* Get the snapshot taken last. Reader only. */
+      const Snapshot& front_slot() const;
+    };
+
+    /* Thread drawing the snapshots published by the game loop.
+     *
+     * Publishing copies a snapshot and posts a semaphore, so the game loop never waits
+     * on the terminal. The thread draws the latest snapshot, skipping the parts that have
+     * not changed since the last one drawn, and writes all windows with one doupdate().
+     * While it runs it is the only thread calling ncurses.
+     */
+    struct Renderer
+    {
+      SnapshotBuffer buffer;
+      profile::Profiler* profiler;
+      sem_t published;
+      std::atomic<bool> stopping{false};
+      std::thread thread;
+
+      // What the render thread drew last
+      bool drawn = false;
+      bool drawn_paused = false;
+      ui::Preview drawn_preview;
+      game::TetriminoType drawn_held_type = game::TetriminoType::NONE;
+
+      /* Start the render thread.
+       *
+       * profiler[out]: If not null, receives the time spent drawing each snapshot and its
+       *                latency from being due to being on screen.
+       */
+      Renderer(profile::Profiler* profiler_init=nullptr);
+
+      ~Renderer();
+
+      Renderer(const Renderer&) = delete;
+      Renderer& operator=(const Renderer&) = delete;
+
+      /* Get the snapshot to fill before the next publish(). */
+      Snapshot& next_snapshot();
+
+      /* Hand the filled snapshot to the render thread. */
+      void publish();
+
+      /* Draw any snapshot still waiting, then stop the render thread. */
+      void stop();
+
+      /* Main loop of the render thread. */
+      void run();
+
+      /* Draw a snapshot to the terminal. */
+      void draw(const Snapshot& snapshot);
+    };
+  }
+}
+
+#endif
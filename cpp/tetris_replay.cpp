@@ -0,0 +1,156 @@
+#include "tetris_replay.hpp"
+#include "tetris_session.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+
+using namespace tetris;
+using namespace tetris::replay;
+
+
+/* Varint Helpers */
+
+namespace
+{
+  void put_varint(std::vector<std::uint8_t>& data, std::uint64_t value)
+  {
+    while (value >= 0x80)
+    {
+      data.push_back((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+    data.push_back(value);
+  }
+
+  bool get_varint(const std::vector<std::uint8_t>& data, size_t& position, std::uint64_t& value)
+  {
+    value = 0;
+    for (short shift=0; shift<64 && position<data.size(); shift+=7)
+    {
+      std::uint8_t byte = data[position++];
+      value |= (std::uint64_t)(byte & 0x7F) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+}
+
+
+/* Recorder Class Methods */
+
+Recorder::Recorder(const session::GameSettings& settings)
+{
+  replay.settings = settings;
+}
+
+void Recorder::record(long frame, session::Command command)
+{
+  if (command != session::Command::DO_NOTHING)
+    replay.events.push_back(Event{frame, command});
+}
+
+void Recorder::finish(long frame)
+{
+  replay.end_frame = frame;
+}
+
+
+/* Free Functions */
+
+std::vector<std::uint8_t> tetris::replay::encode(const Replay& replay)
+{
+  std::vector<std::uint8_t> data(std::begin(MAGIC), std::end(MAGIC));
+  data.push_back(FORMAT_VERSION);
+
+  put_varint(data, replay.settings.seed);
+  data.push_back(replay.settings.gravity);
+  put_varint(data, replay.settings.preview_size);
+
+  long previous_frame = 0;
+  for (const Event& event : replay.events)
+  {
+    put_varint(data, (std::uint64_t)(event.frame - previous_frame) << 4 | (std::uint8_t)event.command);
+    previous_frame = event.frame;
+  }
+  put_varint(data, (std::uint64_t)(replay.end_frame - previous_frame) << 4
+                   | (std::uint8_t)session::Command::DO_NOTHING);
+
+  return data;
+}
+
+bool tetris::replay::decode(const std::vector<std::uint8_t>& data, Replay& replay)
+{
+  if (data.size() < sizeof(MAGIC) + 1
+      || !std::equal(std::begin(MAGIC), std::end(MAGIC), data.begin())
+      || data[sizeof(MAGIC)] != FORMAT_VERSION)
+    return false;
+
+  size_t position = sizeof(MAGIC) + 1;
+  std::uint64_t value;
+
+  if (!get_varint(data, position, value))
+    return false;
+  replay.settings.seed = value;
+
+  if (position >= data.size())
+    return false;
+  replay.settings.gravity = data[position++];
+
+  if (!get_varint(data, position, value))
+    return false;
+  replay.settings.preview_size = value;
+
+  replay.events.clear();
+  long frame = 0;
+  while (get_varint(data, position, value))
+  {
+    frame += value >> 4;
+    if ((value & 0xF) > (std::uint64_t)session::Command::HOLD)
+      return false;
+
+    session::Command command = (session::Command)(value & 0xF);
+    if (command == session::Command::DO_NOTHING)
+    {
+      replay.end_frame = frame;
+      return true;
+    }
+    replay.events.push_back(Event{frame, command});
+  }
+
+  // Stream ended without an end marker
+  return false;
+}
+
+bool tetris::replay::write_file(const std::string& path, const Replay& replay)
+{
+  std::vector<std::uint8_t> data = encode(replay);
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write((const char*)data.data(), data.size());
+  return file.good();
+}
+
+bool tetris::replay::read_file(const std::string& path, Replay& replay)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+
+  std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                 std::istreambuf_iterator<char>());
+  return decode(data, replay);
+}
+
+void tetris::replay::play(const Replay& replay, session::Session& session)
+{
+  for (const Event& event : replay.events)
+  {
+    session.step_frames(event.frame - session.frame);
+    session.apply(event.command);
+  }
+  session.step_frames(replay.end_frame - session.frame);
+}
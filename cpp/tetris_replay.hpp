@@ -0,0 +1,97 @@
+#ifndef TETRIS_REPLAY_HPP
+#define TETRIS_REPLAY_HPP
+
+#include "tetris_session.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tetris
+{
+  namespace replay
+  {
+    /* A command sent during a specific frame of a game. */
+    struct Event
+    {
+      long frame;
+      session::Command command;
+    };
+
+    /* Everything needed to reproduce a game exactly. */
+    struct Replay
+    {
+      session::GameSettings settings;
+      std::vector<Event> events;
+      long end_frame = 0;
+    };
+
+    /* Collects the commands of a game as it is played.
+     *
+     * Frames in which nothing was sent are not stored; each recorded event only keeps the
+     * number of frames since the previous one.
+     */
+    struct Recorder
+    {
+      Replay replay;
+
+      Recorder(const session::GameSettings& settings);
+
+      /* Record a command sent during a frame. DO_NOTHING commands are ignored.
+       *
+       * frame[in]: Frame during which the command was applied.
+       * command[in]: Command applied.
+       */
+      void record(long frame, session::Command command);
+
+      /* Mark the frame at which the game ended. */
+      void finish(long frame);
+    };
+
+    /* File signature and format version.
+     *
+     * Version 1 replays were recorded with whole-frame gravity, capped at one row per
+     * frame and level 15, and would desync under the current rules, so they are rejected.
+     */
+    const char MAGIC[4] = {'T', 'T', 'R', 'P'};
+    const std::uint8_t FORMAT_VERSION = 2;
+
+    /* Encode a replay in the binary replay format.
+     *
+     * The format is the signature, the version, then the seed and settings, followed by
+     * one varint per event holding (frames since previous event << 4 | command). The
+     * stream ends with an entry for DO_NOTHING, whose frame delta leads to the end frame.
+     */
+    std::vector<std::uint8_t> encode(const Replay& replay);
+
+    /* Decode a replay from the binary replay format.
+     *
+     * data[in]: Encoded replay.
+     * replay[out]: Decoded replay.
+     *
+     * return: Whether the data was a valid replay.
+     */
+    bool decode(const std::vector<std::uint8_t>& data, Replay& replay);
+
+    /* Write a replay to a file.
+     *
+     * return: Whether the file was written successfully.
+     */
+    bool write_file(const std::string& path, const Replay& replay);
+
+    /* Read a replay from a file.
+     *
+     * return: Whether the file was read and decoded successfully.
+     */
+    bool read_file(const std::string& path, Replay& replay);
+
+    /* Play a replay back as fast as possible, without any terminal output.
+     *
+     * replay[in]: Replay to play.
+     * session[in,out]: Session freshly created from replay.settings. Left in its final
+     *                 state.
+     */
+    void play(const Replay& replay, session::Session& session);
+  }
+}
+
+#endif
@@ -0,0 +1,275 @@
+#include "tetris_save.hpp"
+#include "tetris_game.hpp"
+#include "tetris_session.hpp"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+
+
+using namespace tetris;
+using namespace tetris::save;
+
+
+namespace
+{
+  /* FNV-1a over a range of bytes, continuing from a previous hash */
+  std::uint64_t fnv1a(const std::uint8_t* begin, const std::uint8_t* end, std::uint64_t hash)
+  {
+    for (const std::uint8_t* byte=begin; byte!=end; byte++)
+      hash = (hash ^ *byte) * 0x100000001B3ULL;
+    return hash;
+  }
+}
+
+
+/* Autosave Class Methods */
+
+Autosave::~Autosave()
+{
+  if (file)
+    munmap(file, sizeof(SaveFile));
+  if (fd >= 0)
+    ::close(fd);
+}
+
+bool Autosave::open(const std::string& path, bool replace_unfinished)
+{
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+  {
+    error = "Could not open save file " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  // Held until the file is closed, so two games never save over each other
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+  {
+    error = errno == EWOULDBLOCK
+      ? "Save file " + path + " is in use by another game"
+      : "Could not lock save file " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  if (ftruncate(fd, sizeof(SaveFile)) != 0)
+  {
+    error = "Could not resize save file " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  void* mapping = mmap(nullptr, sizeof(SaveFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED)
+  {
+    error = "Could not map save file " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  file = (SaveFile*)mapping;
+
+  // Carry on numbering from any saves already in the file
+  bool unfinished = false;
+  for (const SaveState& slot : file->slots)
+  {
+    if (is_valid(slot) && slot.sequence > sequence)
+    {
+      sequence = slot.sequence;
+      unfinished = !slot.over;
+    }
+  }
+
+  if (unfinished && !replace_unfinished)
+  {
+    error = "Save file " + path + " holds an unfinished game; continue it with --resume";
+    return false;
+  }
+
+  return true;
+}
+
+void Autosave::save(const session::Session& session)
+{
+  if (!file)
+    return;
+
+  ++sequence;
+  SaveState& slot = file->slots[sequence % 2];
+  capture(session, slot);
+  slot.sequence = sequence;
+
+  // Make sure the checksum is the last store, so a save cut short never validates
+  std::atomic_signal_fence(std::memory_order_release);
+  slot.checksum = checksum(slot);
+}
+
+
+/* Free Functions */
+
+std::uint64_t tetris::save::checksum(const SaveState& state)
+{
+  const std::uint8_t* begin = (const std::uint8_t*)&state;
+  const std::uint8_t* field = begin + offsetof(SaveState, checksum);
+
+  std::uint64_t hash = 0xCBF29CE484222325ULL;
+  hash = fnv1a(begin, field, hash);
+  hash = fnv1a(field + sizeof(state.checksum), begin + sizeof(SaveState), hash);
+  return hash;
+}
+
+bool tetris::save::is_valid(const SaveState& state)
+{
+  if (!std::equal(std::begin(MAGIC), std::end(MAGIC), state.magic)
+      || state.version != FORMAT_VERSION
+      || state.checksum != checksum(state))
+    return false;
+
+  // Guard against saves from a build with different tables
+  if (state.active_type < 1 || state.active_type > 7 || state.active_facing > 3
+      || state.held_type > 7 || state.queue_size < 7 || state.queue_size > QUEUE_CAPACITY)
+    return false;
+
+  // Or with different limits, whose values the game would index out of range with
+  if (state.preview_size < 0 || state.preview_size > MAX_PREVIEW_SIZE
+      || state.max_level < 1 || state.max_level > game::MAX_LEVEL
+      || state.level < 1 || state.level > state.max_level)
+    return false;
+
+  for (const game::Point& offset : game::MINO_OFFSETS[state.active_type][state.active_facing])
+  {
+    short row = state.active_row + offset.row;
+    short col = state.active_col + offset.col;
+    if (row < 0 || row >= game::Playfield::HEIGHT || col < 0 || col >= game::Playfield::WIDTH)
+      return false;
+  }
+
+  for (short i=0; i<state.queue_size; i++)
+    if (state.queue[i] < 1 || state.queue[i] > 7)
+      return false;
+
+  for (const std::array<std::uint8_t, game::Playfield::WIDTH>& row : state.grid)
+    for (std::uint8_t cell : row)
+      if (cell > 7)
+        return false;
+
+  return true;
+}
+
+void tetris::save::capture(const session::Session& session, SaveState& state)
+{
+  const game::Game& game = session.game;
+
+  std::copy(std::begin(MAGIC), std::end(MAGIC), state.magic);
+  state.version = FORMAT_VERSION;
+  state.gravity = session.settings.gravity;
+  state.over = session.is_over() && session.end_type == session::EndType::GAME_OVER;
+  state.hold_available = game.hold_available;
+
+  state.seed = session.settings.seed;
+  state.random_state = game.bag.random_generator.state;
+  state.frame = session.frame;
+  state.last_drop = session.last_drop;
+  state.score = game.score;
+  state.total_tetriminoes_locked = game.total_tetriminoes_locked;
+
+  state.preview_size = session.settings.preview_size;
+  state.level = game.level;
+  state.total_rows_cleared = game.total_rows_cleared;
+  state.total_rows_cleared_for_next_level = game.total_rows_cleared_for_next_level;
+  state.max_level = game.max_level;
+  state.active_row = game.active_tetrimino.pivot.row;
+  state.active_col = game.active_tetrimino.pivot.col;
+
+  state.active_type = (std::uint8_t)game.active_tetrimino.type;
+  state.active_facing = (std::uint8_t)game.active_tetrimino.facing;
+  state.held_type = (std::uint8_t)game.held_tetrimino.type;
+  state.queue_size = std::min<std::size_t>(game.bag.tetrimino_queue.size(), QUEUE_CAPACITY);
+  for (short i=0; i<state.queue_size; i++)
+    state.queue[i] = (std::uint8_t)game.bag.tetrimino_queue[i].type;
+
+  for (short row=0; row<game::Playfield::HEIGHT; row++)
+    for (short col=0; col<game::Playfield::WIDTH; col++)
+      state.grid[row][col] = (std::uint8_t)game.playfield.grid[row][col];
+  state.reserved.fill(0);
+}
+
+session::GameSettings tetris::save::saved_settings(const SaveState& state)
+{
+  session::GameSettings settings;
+  settings.gravity = state.gravity;
+  settings.preview_size = state.preview_size;
+  settings.seed = state.seed;
+  return settings;
+}
+
+void tetris::save::restore(const SaveState& state, session::Session& session)
+{
+  game::Game& game = session.game;
+
+  session.frame = state.frame;
+  session.last_drop = state.last_drop;
+
+  game.hold_available = state.hold_available;
+  game.score = state.score;
+  game.total_tetriminoes_locked = state.total_tetriminoes_locked;
+  game.level = state.level;
+  game.total_rows_cleared = state.total_rows_cleared;
+  game.total_rows_cleared_for_next_level = state.total_rows_cleared_for_next_level;
+  game.max_level = state.max_level;
+
+  game.playfield = game::Playfield();
+  for (short row=0; row<game::Playfield::HEIGHT; row++)
+    for (short col=0; col<game::Playfield::WIDTH; col++)
+      if (state.grid[row][col] != (std::uint8_t)game::TetriminoType::NONE)
+        game.playfield.set(game::Point(row, col), (game::TetriminoType)state.grid[row][col]);
+
+  game::Tetrimino& active = game.active_tetrimino;
+  active = game::Tetrimino((game::TetriminoType)state.active_type);
+  active.facing = (game::TetriminoFacing)state.active_facing;
+  active.pivot = game::Point(state.active_row, state.active_col);
+  for (short i=0; i<4; i++)
+    active.points[i] = active.pivot + game::MINO_OFFSETS[state.active_type][state.active_facing][i];
+
+  game.held_tetrimino = game::Tetrimino((game::TetriminoType)state.held_type);
+
+  game.bag.random_generator.state = state.random_state;
+  game.bag.tetrimino_queue.clear();
+  for (short i=0; i<state.queue_size; i++)
+    game.bag.tetrimino_queue.push_back(game::Tetrimino((game::TetriminoType)state.queue[i]));
+}
+
+bool tetris::save::read_file(const std::string& path, SaveState& state)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  bool found = false;
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size >= (off_t)sizeof(SaveFile))
+  {
+    void* mapping = mmap(nullptr, sizeof(SaveFile), PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping != MAP_FAILED)
+    {
+      const SaveFile* file = (const SaveFile*)mapping;
+      for (const SaveState& slot : file->slots)
+      {
+        if (is_valid(slot) && (!found || slot.sequence > state.sequence))
+        {
+          state = slot;
+          found = true;
+        }
+      }
+      munmap(mapping, sizeof(SaveFile));
+    }
+  }
+
+  ::close(fd);
+  return found;
+}
@@ -0,0 +1,149 @@
+#ifndef TETRIS_SAVE_HPP
+#define TETRIS_SAVE_HPP
+
+#include "tetris_session.hpp"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace tetris
+{
+  namespace save
+  {
+    /* File signature and format version. */
+    const char MAGIC[4] = {'T', 'T', 'S', 'V'};
+    const std::uint8_t FORMAT_VERSION = 1;
+
+    /* Room for the bag queue, which holds between 7 and 13 tetriminoes. */
+    const short QUEUE_CAPACITY = 16;
+
+    /* Largest preview size a save may hold, as allowed on the command line. */
+    const short MAX_PREVIEW_SIZE = 6;
+
+    /* Everything needed to continue a session from the moment a tetrimino was drawn.
+     *
+     * Saves are only taken right after a lock or a hold, when the active tetrimino is
+     * at its spawn position and placement control is reset, so frame and drop timing are
+     * the only session state needed besides the game itself.
+     *
+     * Fixed-width fields laid out without padding, so the block can live directly in a
+     * mapped file. The checksum covers every other byte.
+     */
+    struct SaveState
+    {
+      char magic[4];
+      std::uint8_t version;
+      std::uint8_t gravity;
+      std::uint8_t over;            // Session ended in a game over, so cannot be resumed
+      std::uint8_t hold_available;
+
+      std::uint64_t sequence;       // Incremented by every save
+      std::uint64_t checksum;
+      std::uint64_t seed;
+      std::uint64_t random_state;
+      std::int64_t frame;
+      std::int64_t last_drop;
+      std::int64_t score;
+      std::int64_t total_tetriminoes_locked;
+
+      std::int16_t preview_size;
+      std::int16_t level;
+      std::int16_t total_rows_cleared;
+      std::int16_t total_rows_cleared_for_next_level;
+      std::int16_t max_level;
+      std::int16_t active_row;
+      std::int16_t active_col;
+
+      std::uint8_t active_type;
+      std::uint8_t active_facing;
+      std::uint8_t held_type;
+      std::uint8_t queue_size;
+      std::array<std::uint8_t, QUEUE_CAPACITY> queue;
+      std::array<std::array<std::uint8_t, game::Playfield::WIDTH>, game::Playfield::HEIGHT> grid;
+      std::array<std::uint8_t, 6> reserved;
+    };
+
+    static_assert(std::is_trivially_copyable<SaveState>::value, "SaveState must be POD");
+    static_assert(sizeof(SaveState) == 512, "SaveState must not contain padding");
+
+    /* Layout of a save file: two slots, written alternately.
+     *
+     * A save only ever overwrites the older slot, so if the process dies part way through
+     * writing one, the other still holds the previous save.
+     */
+    struct SaveFile
+    {
+      std::array<SaveState, 2> slots;
+    };
+
+    /* Keeps a save file mapped into memory and writes the session to it in place.
+     *
+     * Saving writes the session's state straight into the mapped slot and nothing else:
+     * there is no system call or fsync, so it is cheap enough for the game loop. The
+     * kernel writes the pages back in its own time, and they survive the process being
+     * killed, though not the machine losing power before writeback.
+     */
+    struct Autosave
+    {
+      int fd = -1;
+      SaveFile* file = nullptr;
+      std::uint64_t sequence = 0;
+      std::string error;
+
+      Autosave() = default;
+
+      ~Autosave();
+
+      Autosave(const Autosave&) = delete;
+      Autosave& operator=(const Autosave&) = delete;
+
+      /* Create or open a save file, lock it against other games and map it.
+       *
+       * Saves already in the file are kept until overwritten, so a file can be resumed
+       * from and then saved to again.
+       *
+       * path[in]: Save file.
+       * replace_unfinished[in]: Whether a file whose newest save is of a game not yet
+       *                         over may be saved to, as when that game is resumed.
+       *
+       * return: Whether the file is ready; if not, error describes why.
+       */
+      bool open(const std::string& path, bool replace_unfinished);
+
+      /* Save a session into the older slot. Does nothing if no file is open. */
+      void save(const session::Session& session);
+    };
+
+    /* Get the checksum of a save, over every byte other than the checksum itself. */
+    std::uint64_t checksum(const SaveState& state);
+
+    /* Check whether a slot holds a complete, well-formed save. */
+    bool is_valid(const SaveState& state);
+
+    /* Copy a session's state into a save, leaving its sequence and checksum untouched. */
+    void capture(const session::Session& session, SaveState& state);
+
+    /* Get the settings a saved session was played with. */
+    session::GameSettings saved_settings(const SaveState& state);
+
+    /* Continue a saved session.
+     *
+     * state[in]: Valid save.
+     * session[out]: Session created from saved_settings(state), which takes on the saved
+     *               state.
+     */
+    void restore(const SaveState& state, session::Session& session);
+
+    /* Read the newest valid save from a save file.
+     *
+     * path[in]: Save file to read.
+     * state[out]: Newest valid save.
+     *
+     * return: Whether the file held a valid save.
+     */
+    bool read_file(const std::string& path, SaveState& state);
+  }
+}
+
+#endif
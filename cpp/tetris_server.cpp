@@ -0,0 +1,585 @@
+#include "tetris_server.hpp"
+#include "tetris_ansi.hpp"
+#include "tetris_input.hpp"
+#include "tetris_log.hpp"
+#include "tetris_session.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+
+
+using namespace tetris;
+using namespace tetris::server;
+
+
+namespace
+{
+  /* Telnet bytes used to negotiate character-at-a-time input without local echo */
+  const unsigned char TELNET_IAC  = 255;
+  const unsigned char TELNET_WILL = 251;
+  const unsigned char TELNET_SB   = 250;
+  const unsigned char TELNET_SE   = 240;
+  const unsigned char TELNET_ECHO = 1;
+  const unsigned char TELNET_SGA  = 3;
+
+  /* Sent before disconnecting, so the player's terminal is left usable */
+  const char GOODBYE[] = "\x1b[0m\x1b[?25h\x1b[24;1H\r\n";
+
+  /* Events that can be waited for in one epoll_wait call */
+  const short MAX_EPOLL_EVENTS = 64;
+
+  const std::chrono::duration<double> TICK(session::TICK_DURATION);
+
+  /* Advance a connection's session to the frame that is due now.
+   *
+   * return: StepEvent bitmask.
+   */
+  short catch_up(Connection& connection)
+  {
+    if (connection.session.is_over())
+      return session::StepEvent::NONE;
+
+    long due_frame = (std::chrono::steady_clock::now() - connection.game_start) / TICK;
+    if (connection.session.frame >= due_frame)
+      return session::StepEvent::NONE;
+
+    return connection.session.step_frames(due_frame - connection.session.frame);
+  }
+
+  /* Pass one input byte of a telnet connection through its command parser.
+   *
+   * return: Whether the byte is player input rather than part of a telnet command.
+   */
+  bool filter_telnet(Connection& connection, unsigned char byte)
+  {
+    switch (connection.telnet_state)
+    {
+      case TelnetState::DATA:
+        if (byte != TELNET_IAC)
+          return true;
+        connection.telnet_state = TelnetState::COMMAND;
+        return false;
+
+      case TelnetState::COMMAND:
+        if (byte == TELNET_SB)
+          connection.telnet_state = TelnetState::SUBNEGOTIATION;
+        else if (byte > TELNET_SB && byte < TELNET_IAC)
+          connection.telnet_state = TelnetState::OPTION;
+        else
+          connection.telnet_state = TelnetState::DATA;
+        return false;
+
+      case TelnetState::OPTION:
+        connection.telnet_state = TelnetState::DATA;
+        return false;
+
+      case TelnetState::SUBNEGOTIATION:
+        if (byte == TELNET_IAC)
+          connection.telnet_state = TelnetState::SUBNEGOTIATION_COMMAND;
+        return false;
+
+      case TelnetState::SUBNEGOTIATION_COMMAND:
+        connection.telnet_state = byte == TELNET_SE
+          ? TelnetState::DATA
+          : TelnetState::SUBNEGOTIATION;
+        return false;
+    }
+    return false;
+  }
+
+  /* Raise an atomic maximum to at least value */
+  void raise_to(std::atomic<long>& maximum, long value)
+  {
+    long current = maximum.load(std::memory_order_relaxed);
+    while (current < value && !maximum.compare_exchange_weak(current, value))
+      ;
+  }
+}
+
+
+/* Connection Class Methods */
+
+Connection::Connection(int fd_init, bool telnet_init, const session::GameSettings& settings)
+  : fd(fd_init),
+    telnet(telnet_init),
+    session(settings),
+    renderer(settings.preview_size),
+    game_start(std::chrono::steady_clock::now())
+{}
+
+long Connection::memory_usage() const
+{
+  // Heap allocations are the output buffer and the bag's queue; the rest is inline
+  return sizeof(Connection)
+    + output.capacity()
+    + session.game.bag.tetrimino_queue.size() * sizeof(game::Tetrimino);
+}
+
+
+/* EventLoop Class Methods */
+
+EventLoop::EventLoop(std::uint64_t seed)
+  : seeds(seed)
+{
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+EventLoop::~EventLoop()
+{
+  if (epoll_fd >= 0)
+    close(epoll_fd);
+  if (wake_fd >= 0)
+    close(wake_fd);
+}
+
+
+/* Server Class Methods */
+
+Server::Server(const ServerSettings& settings_init)
+  : settings(settings_init)
+{}
+
+Server::~Server()
+{
+  stop();
+}
+
+bool Server::start()
+{
+  // Open listening socket
+  if (!settings.unix_path.empty())
+  {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (settings.unix_path.size() >= sizeof(address.sun_path))
+    {
+      error = "Socket path is too long: " + settings.unix_path;
+      return false;
+    }
+    std::strcpy(address.sun_path, settings.unix_path.c_str());
+
+    // Replace a socket left behind by a previous server, but nothing else
+    struct stat existing;
+    if (stat(settings.unix_path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+      unlink(settings.unix_path.c_str());
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 || bind(listen_fd, (sockaddr*)&address, sizeof(address)) < 0)
+    {
+      error = "Could not bind " + settings.unix_path + ": " + std::strerror(errno);
+      return false;
+    }
+  }
+  else
+  {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(settings.port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int reuse = 1;
+    if (listen_fd < 0
+        || setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0
+        || bind(listen_fd, (sockaddr*)&address, sizeof(address)) < 0)
+    {
+      error = "Could not bind port " + std::to_string(settings.port) + ": " + std::strerror(errno);
+      return false;
+    }
+  }
+
+  if (listen(listen_fd, SOMAXCONN) < 0)
+  {
+    error = std::string("Could not listen: ") + std::strerror(errno);
+    return false;
+  }
+
+  // Start event loops, each waiting on the listening socket; the kernel wakes only one of
+  // them per new connection
+  unsigned thread_count = settings.threads;
+  if (thread_count == 0)
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+  std::random_device rd;
+  for (unsigned i=0; i<thread_count; i++)
+  {
+    std::unique_ptr<EventLoop> loop
+      = std::make_unique<EventLoop>(((std::uint64_t)rd() << 32) | rd());
+    if (loop->epoll_fd < 0 || loop->wake_fd < 0)
+    {
+      error = std::string("Could not create event loop: ") + std::strerror(errno);
+      return false;
+    }
+
+    epoll_event listen_event{};
+    listen_event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    listen_event.data.fd = listen_fd;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_event);
+
+    epoll_event wake_event{};
+    wake_event.events = EPOLLIN;
+    wake_event.data.fd = loop->wake_fd;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &wake_event);
+
+    loops.push_back(std::move(loop));
+  }
+
+  for (std::unique_ptr<EventLoop>& loop : loops)
+    loop->thread = std::thread(&Server::run, this, std::ref(*loop));
+
+  return true;
+}
+
+void Server::stop()
+{
+  stopping = true;
+
+  std::uint64_t wake = 1;
+  for (std::unique_ptr<EventLoop>& loop : loops)
+    if (write(loop->wake_fd, &wake, sizeof(wake)) < 0)
+      TETRIS_LOG_WARNING("Could not wake event loop: " << std::strerror(errno));
+
+  for (std::unique_ptr<EventLoop>& loop : loops)
+    if (loop->thread.joinable())
+      loop->thread.join();
+  loops.clear();
+
+  if (listen_fd >= 0)
+  {
+    close(listen_fd);
+    listen_fd = -1;
+    if (!settings.unix_path.empty())
+      unlink(settings.unix_path.c_str());
+  }
+}
+
+ServerStats Server::stats() const
+{
+  ServerStats snapshot;
+  snapshot.sessions = sessions.load();
+  snapshot.peak_sessions = peak_sessions.load();
+  snapshot.total_sessions = total_sessions.load();
+  snapshot.memory = memory.load();
+  snapshot.max_session_memory = max_session_memory.load();
+  return snapshot;
+}
+
+void Server::run(EventLoop& loop)
+{
+  std::array<epoll_event, MAX_EPOLL_EVENTS> events;
+
+  while (!stopping)
+  {
+    // Sleep until a socket is ready or the earliest session deadline
+    int timeout = -1;
+    if (!loop.timers.empty())
+    {
+      std::chrono::milliseconds wait = std::chrono::ceil<std::chrono::milliseconds>(
+        loop.timers.begin()->first - std::chrono::steady_clock::now());
+      timeout = std::max(0L, (long)wait.count());
+    }
+
+    int count = epoll_wait(loop.epoll_fd, events.data(), MAX_EPOLL_EVENTS, timeout);
+    for (int i=0; i<count; i++)
+    {
+      int fd = events[i].data.fd;
+      if (fd == listen_fd)
+      {
+        accept_connections(loop);
+        continue;
+      }
+
+      // Waking is enough for the loop to notice that the server is stopping
+      if (fd == loop.wake_fd)
+      {
+        std::uint64_t wake;
+        read(loop.wake_fd, &wake, sizeof(wake));
+        continue;
+      }
+
+      auto connection = loop.connections.find(fd);
+      if (connection == loop.connections.end())
+        continue;
+
+      if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        if (!handle_input(loop, *connection->second))
+          continue;
+
+      if (events[i].events & EPOLLOUT)
+        flush(loop, *connection->second);
+    }
+
+    // Update sessions whose deadline has come
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while (!loop.timers.empty() && loop.timers.begin()->first <= now)
+    {
+      int fd = loop.timers.begin()->second;
+      loop.timers.erase(loop.timers.begin());
+
+      auto connection = loop.connections.find(fd);
+      if (connection == loop.connections.end())
+        continue;
+
+      connection->second->wake_scheduled = false;
+      update(loop, *connection->second, session::StepEvent::NONE);
+    }
+  }
+
+  while (!loop.connections.empty())
+    close_connection(loop, *loop.connections.begin()->second);
+}
+
+void Server::accept_connections(EventLoop& loop)
+{
+  while (true)
+  {
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+
+    if (sessions.fetch_add(1) >= settings.max_sessions)
+    {
+      --sessions;
+      const char full[] = "Server full\r\n";
+      send(fd, full, sizeof(full) - 1, MSG_NOSIGNAL);
+      close(fd);
+      continue;
+    }
+    raise_to(peak_sessions, sessions.load());
+    ++total_sessions;
+
+    bool telnet = settings.unix_path.empty();
+    if (telnet)
+    {
+      int no_delay = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    }
+
+    session::GameSettings game_settings = settings.game_settings;
+    game_settings.seed = loop.seeds.next();
+    std::unique_ptr<Connection> connection
+      = std::make_unique<Connection>(fd, telnet, game_settings);
+
+    // Ask telnet clients to send each key as it is pressed, without echoing it
+    if (telnet)
+    {
+      const unsigned char negotiation[] = {
+        TELNET_IAC, TELNET_WILL, TELNET_ECHO,
+        TELNET_IAC, TELNET_WILL, TELNET_SGA,
+      };
+      connection->output.append((const char*)negotiation, sizeof(negotiation));
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, fd, &event);
+
+    Connection& added = *connection;
+    loop.connections.emplace(fd, std::move(connection));
+    TETRIS_LOG_INFO("Connection " << fd << " opened with seed " << game_settings.seed);
+
+    update(loop, added, session::StepEvent::NONE);
+  }
+}
+
+bool Server::handle_input(EventLoop& loop, Connection& connection)
+{
+  short events = catch_up(connection);
+
+  // Execute every key press read during the current frame, as play_game does, so
+  // sending keys faster never moves the session ahead of the wall clock
+  std::array<char, READ_BUFFER_SIZE> buffer;
+  while (true)
+  {
+    ssize_t length = recv(connection.fd, buffer.data(), buffer.size(), 0);
+    if (length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+    {
+      close_connection(loop, connection);
+      return false;
+    }
+    if (length < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    for (ssize_t i=0; i<length; i++)
+    {
+      unsigned char byte = buffer[i];
+      if (connection.telnet && !filter_telnet(connection, byte))
+        continue;
+
+      session::Command command = input::command_for_key(byte);
+      if (command == session::Command::DO_NOTHING)
+        continue;
+
+      // After a game over, only retry and quit are accepted
+      if (connection.game_over_shown)
+      {
+        if (command == session::Command::QUIT)
+        {
+          close_connection(loop, connection);
+          return false;
+        }
+        if (command == session::Command::RESTART)
+        {
+          restart(loop, connection);
+          events |= session::StepEvent::MOVED;
+        }
+        continue;
+      }
+
+      if (connection.session.is_over())
+        continue;
+
+      events |= connection.session.apply(command);
+    }
+  }
+
+  return update(loop, connection, events);
+}
+
+bool Server::update(EventLoop& loop, Connection& connection, short events)
+{
+  events |= catch_up(connection);
+
+  if (connection.session.is_over() && !connection.game_over_shown)
+  {
+    switch (connection.session.end_type)
+    {
+      case session::EndType::QUIT:
+        close_connection(loop, connection);
+        return false;
+
+      case session::EndType::RESTART:
+        restart(loop, connection);
+        events |= session::StepEvent::MOVED;
+        break;
+
+      case session::EndType::GAME_OVER:
+        connection.renderer.draw(connection.session, connection.output);
+        connection.renderer.draw_game_over(connection.output);
+        connection.game_over_shown = true;
+        break;
+    }
+  }
+
+  // Draw only if something changed
+  if (!connection.session.is_over()
+      && (events != session::StepEvent::NONE || !connection.renderer.drawn))
+    connection.renderer.draw(connection.session, connection.output);
+
+  // Sleep until the session's next deadline
+  if (connection.wake_scheduled)
+  {
+    loop.timers.erase(std::make_pair(connection.wake_time, connection.fd));
+    connection.wake_scheduled = false;
+  }
+
+  long deadline = connection.session.frames_until_deadline();
+  if (deadline != session::NO_DEADLINE)
+  {
+    connection.wake_time = connection.game_start
+      + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          (connection.session.frame + deadline + 1) * TICK);
+    loop.timers.emplace(connection.wake_time, connection.fd);
+    connection.wake_scheduled = true;
+  }
+
+  return flush(loop, connection);
+}
+
+bool Server::flush(EventLoop& loop, Connection& connection)
+{
+  while (connection.output_sent < connection.output.size())
+  {
+    ssize_t length = send(connection.fd,
+                          connection.output.data() + connection.output_sent,
+                          connection.output.size() - connection.output_sent,
+                          MSG_NOSIGNAL);
+    if (length < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      close_connection(loop, connection);
+      return false;
+    }
+    connection.output_sent += length;
+  }
+
+  std::size_t backlog = connection.output.size() - connection.output_sent;
+  if (backlog == 0)
+  {
+    connection.output.clear();
+    connection.output_sent = 0;
+    if (connection.output.capacity() > OUTPUT_BUFFER_RETAIN)
+      std::string().swap(connection.output);
+  }
+  else if (backlog > MAX_OUTPUT_BACKLOG)
+  {
+    TETRIS_LOG_WARNING("Connection " << connection.fd << " dropped with "
+                       << backlog << " bytes of output backlog");
+    close_connection(loop, connection);
+    return false;
+  }
+
+  // Wait for the socket to accept more only while output is pending
+  epoll_event event{};
+  event.events = backlog ? EPOLLIN | EPOLLOUT : EPOLLIN;
+  event.data.fd = connection.fd;
+  epoll_ctl(loop.epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+
+  // Account for this connection's memory
+  long usage = connection.memory_usage();
+  memory += usage - connection.reported_memory;
+  connection.reported_memory = usage;
+  raise_to(max_session_memory, usage);
+
+  return true;
+}
+
+void Server::close_connection(EventLoop& loop, Connection& connection)
+{
+  int fd = connection.fd;
+  send(fd, GOODBYE, sizeof(GOODBYE) - 1, MSG_NOSIGNAL);
+  epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+  close(fd);
+
+  if (connection.wake_scheduled)
+    loop.timers.erase(std::make_pair(connection.wake_time, fd));
+
+  --sessions;
+  memory -= connection.reported_memory;
+  TETRIS_LOG_INFO("Connection " << fd << " closed after "
+                  << connection.session.game.total_tetriminoes_locked << " tetriminoes");
+
+  loop.connections.erase(fd);
+}
+
+void Server::restart(EventLoop& loop, Connection& connection)
+{
+  session::GameSettings game_settings = settings.game_settings;
+  game_settings.seed = loop.seeds.next();
+  connection.session = session::Session(game_settings);
+  connection.game_start = std::chrono::steady_clock::now();
+  connection.game_over_shown = false;
+}
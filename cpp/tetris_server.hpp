@@ -0,0 +1,174 @@
+#ifndef TETRIS_SERVER_HPP
+#define TETRIS_SERVER_HPP
+
+#include "tetris_ansi.hpp"
+#include "tetris_game.hpp"
+#include "tetris_session.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace tetris
+{
+  namespace server
+  {
+    /* Terminal output a connection may have waiting before it is dropped as too slow. */
+    const std::size_t MAX_OUTPUT_BACKLOG = 64 * 1024;
+
+    /* Output buffer capacity kept between writes; larger buffers are released. */
+    const std::size_t OUTPUT_BUFFER_RETAIN = 4 * 1024;
+
+    /* Bytes read from a connection at a time. */
+    const std::size_t READ_BUFFER_SIZE = 256;
+
+    /* Struct for server settings */
+    struct ServerSettings
+    {
+      std::string unix_path;        // Listen on this Unix socket path, if not empty
+      unsigned short port = 0;      // Otherwise listen on this TCP port on the loopback address
+      unsigned threads = 0;         // Event loop threads; 0 for one per hardware thread
+      long max_sessions = 10000;
+      session::GameSettings game_settings;
+    };
+
+    /* Struct for server-wide counters */
+    struct ServerStats
+    {
+      long sessions = 0;
+      long peak_sessions = 0;
+      long total_sessions = 0;
+      long memory = 0;              // Estimated bytes held by all open sessions
+      long max_session_memory = 0;  // Largest estimate seen for a single session
+    };
+
+    /* Enum to track telnet commands in the input of a TCP connection */
+    enum class TelnetState : std::uint8_t
+    {
+      DATA,
+      COMMAND,
+      OPTION,
+      SUBNEGOTIATION,
+      SUBNEGOTIATION_COMMAND,
+    };
+
+    /* One connected player: a session, its renderer and its socket buffers. */
+    struct Connection
+    {
+      int fd;
+      bool telnet;
+      TelnetState telnet_state = TelnetState::DATA;
+      session::Session session;
+      ansi::Renderer renderer;
+      bool game_over_shown = false;
+
+      // Time control; frame n is due to be advanced at game_start + (n + 1) ticks
+      std::chrono::steady_clock::time_point game_start;
+      std::chrono::steady_clock::time_point wake_time;
+      bool wake_scheduled = false;
+
+      // Output not yet accepted by the socket
+      std::string output;
+      std::size_t output_sent = 0;
+      long reported_memory = 0;
+
+      Connection(int fd_init, bool telnet_init, const session::GameSettings& settings);
+
+      /* Estimate the bytes held by this connection, excluding kernel socket buffers. */
+      long memory_usage() const;
+    };
+
+    /* One event loop thread, and the connections it owns. */
+    struct EventLoop
+    {
+      int epoll_fd = -1;
+      int wake_fd = -1;
+      std::thread thread;
+      std::unordered_map<int, std::unique_ptr<Connection>> connections;
+      std::set<std::pair<std::chrono::steady_clock::time_point, int>> timers; // (wake time, fd)
+      game::Random seeds;
+
+      EventLoop(std::uint64_t seed);
+
+      ~EventLoop();
+    };
+
+    /* Hosts many games in one process, for players connecting over a socket.
+     *
+     * Each connection gets its own session and ANSI renderer. Connections are owned by the
+     * event loop thread that accepted them, which sleeps until a socket is readable or one
+     * of its sessions reaches its next gravity or lock deadline.
+     */
+    struct Server
+    {
+      ServerSettings settings;
+      int listen_fd = -1;
+      std::vector<std::unique_ptr<EventLoop>> loops;
+      std::atomic<bool> stopping{false};
+      std::string error;
+
+      // Counters shared by all loops
+      std::atomic<long> sessions{0};
+      std::atomic<long> peak_sessions{0};
+      std::atomic<long> total_sessions{0};
+      std::atomic<long> memory{0};
+      std::atomic<long> max_session_memory{0};
+
+      Server(const ServerSettings& settings_init);
+
+      ~Server();
+
+      /* Open the listening socket and start the event loop threads.
+       *
+       * return: Whether the server started; if not, error describes why.
+       */
+      bool start();
+
+      /* Stop the event loops, disconnect every player and close the listening socket. */
+      void stop();
+
+      /* Get a snapshot of the server-wide counters. */
+      ServerStats stats() const;
+
+      /* Run one event loop until the server stops. */
+      void run(EventLoop& loop);
+
+      /* Accept all pending connections onto a loop. */
+      void accept_connections(EventLoop& loop);
+
+      /* Read and execute a connection's input, then update it.
+       *
+       * return: Whether the connection is still open.
+       */
+      bool handle_input(EventLoop& loop, Connection& connection);
+
+      /* Catch the session up to the current time, draw it and reschedule its deadline.
+       *
+       * events[in]: StepEvent bitmask of changes since the last update.
+       *
+       * return: Whether the connection is still open.
+       */
+      bool update(EventLoop& loop, Connection& connection, short events);
+
+      /* Write as much pending output as the socket accepts.
+       *
+       * return: Whether the connection is still open.
+       */
+      bool flush(EventLoop& loop, Connection& connection);
+
+      /* Close a connection and forget it. The reference is invalid afterwards. */
+      void close_connection(EventLoop& loop, Connection& connection);
+
+      /* Start a new game on a connection. */
+      void restart(EventLoop& loop, Connection& connection);
+    };
+  }
+}
+
+#endif
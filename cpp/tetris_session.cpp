@@ -0,0 +1,351 @@
+#include "tetris_session.hpp"
+#include "tetris_game.hpp"
+#include "tetris_movegen.hpp"
+#include "tetris_stats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+
+using namespace tetris;
+using namespace tetris::session;
+
+
+namespace
+{
+  /* Get the rows gravity moves a tetrimino down during the given frame since its last
+   * drop. Below 1G this is one row once enough frames have passed; from 1G it is the
+   * whole rows gained during that frame alone.
+   */
+  long rows_due(std::int64_t gravity, long frames_since_drop)
+  {
+    if (frames_since_drop <= 0)
+      return 0;
+
+    if (gravity < game::GRAVITY_ONE)
+      return frames_since_drop * gravity >= game::GRAVITY_ONE ? 1 : 0;
+
+    return (frames_since_drop * gravity >> 16) - ((frames_since_drop - 1) * gravity >> 16);
+  }
+
+  /* Get the fewest inputs that move a tetrimino from its spawn state to where it now
+   * rests and lock it there, counting a run of soft drops as one input, or -1 if the
+   * move search cannot reach it.
+   */
+  short get_fewest_inputs(const game::Tetrimino& tetrimino, const game::Playfield& playfield)
+  {
+    // Created on first use, then kept for the thread's later games
+    thread_local std::unique_ptr<movegen::MoveGenerator> generator;
+    if (!generator)
+      generator = std::make_unique<movegen::MoveGenerator>();
+
+    game::Tetrimino start(tetrimino.type);
+    short placement_count = generator->generate(start, playfield, true);
+    std::uint64_t key = movegen::cell_key(tetrimino);
+    for (short i=0; i<placement_count; i++)
+    {
+      const movegen::Placement& placement = generator->placements[i];
+      if (movegen::cell_key(placement.tetrimino()) != key)
+        continue;
+
+      // The path spells out each drop of the search as a run of soft drops
+      short inputs = 0;
+      for (short j=0; j<placement.path_length; j++)
+      {
+        bool continues_drop = j > 0
+          && placement.path[j] == Command::SOFT_DROP
+          && placement.path[j-1] == Command::SOFT_DROP;
+        if (!continues_drop)
+          ++inputs;
+      }
+      return inputs;
+    }
+
+    return -1;
+  }
+}
+
+
+/* GameResult Class Methods */
+
+GameResult::GameResult() {}
+
+GameResult::GameResult(EndType end_type_init,
+                       short end_level_init,
+                       long end_score_init,
+                       const stats::Summary& stats_init)
+  : end_type(end_type_init),
+    end_level(end_level_init),
+    end_score(end_score_init),
+    stats(stats_init)
+{}
+
+
+/* Session Class Methods */
+
+Session::Session(const GameSettings& settings_init)
+  : settings(settings_init),
+    game(settings_init.seed)
+{
+  game.draw_new_tetrimino();
+}
+
+short Session::apply(Command command, bool repeat)
+{
+  if (over)
+    return StepEvent::ENDED;
+
+  // Quit early if needed
+  if (command == Command::QUIT || command == Command::RESTART)
+  {
+    over = true;
+    end_type = command == Command::QUIT ? EndType::QUIT : EndType::RESTART;
+    return StepEvent::ENDED;
+  }
+
+  if (paused)
+  {
+    if (command == Command::PAUSE)
+    {
+      paused = false;
+      return StepEvent::PAUSE;
+    }
+    return StepEvent::NONE;
+  }
+
+  if (command != Command::DO_NOTHING && command != Command::PAUSE && !repeat)
+    stats.action();
+
+  if (settings.gravity
+      && extended_placement_active
+      && extended_placement_moves > EXTENDED_PLACEMENT_MAX_MOVES)
+    return StepEvent::NONE;
+
+  bool move_executed = false;
+  switch (command)
+  {
+    case Command::PAUSE:
+      paused = true;
+      return StepEvent::PAUSE;
+
+    case Command::SHIFT_LEFT:
+      move_executed = game.active_tetrimino.translate(game::Point(0, -1), game.playfield);
+      break;
+
+    case Command::SHIFT_RIGHT:
+      move_executed = game.active_tetrimino.translate(game::Point(0, 1), game.playfield);
+      break;
+
+    case Command::ROTATE_CCW:
+      move_executed = game.active_tetrimino.rotate_ccw(game.playfield);
+      break;
+
+    case Command::ROTATE_CW:
+      move_executed = game.active_tetrimino.rotate_cw(game.playfield);
+      break;
+
+    case Command::SOFT_DROP:
+      move_executed = game.active_tetrimino.translate(game::Point(1, 0), game.playfield);
+      if (move_executed)
+        last_drop = frame;
+      break;
+
+    case Command::HARD_DROP:
+      move_executed = game.active_tetrimino.hard_drop(game.playfield);
+      if (move_executed)
+        hard_drop = true;
+      break;
+
+    case Command::HOLD:
+      if (game.hold_active_tetrimino())
+      {
+        // The swapped-in tetrimino starts afresh at the top of the playfield
+        extended_placement_active = false;
+        last_drop = frame;
+        stats.piece_held();
+        if (game.is_game_over())
+        {
+          over = true;
+          end_type = EndType::GAME_OVER;
+          return StepEvent::HELD | StepEvent::ENDED;
+        }
+        return StepEvent::HELD;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  if (move_executed && !repeat)
+    stats.input(command == Command::SOFT_DROP);
+
+  if (move_executed && extended_placement_active)
+  {
+    extended_placement_start = frame;
+    ++extended_placement_moves;
+  }
+
+  return move_executed ? StepEvent::MOVED : StepEvent::NONE;
+}
+
+short Session::advance()
+{
+  if (over)
+    return StepEvent::ENDED;
+
+  short events = StepEvent::NONE;
+
+  if (!paused)
+  {
+    // Process drop, falling as far as gravity allows towards the landing
+    if (settings.gravity)
+    {
+      long rows = rows_due(game.get_gravity(), frame - last_drop);
+      if (rows > 0)
+      {
+        short distance = game.active_tetrimino.get_landing(game.playfield).pivot.row
+          - game.active_tetrimino.pivot.row;
+        bool fell = distance > 0
+          && game.active_tetrimino.translate(game::Point(std::min<long>(rows, distance), 0),
+                                             game.playfield);
+        if (fell)
+        {
+          events |= StepEvent::MOVED;
+
+          // Only a new lowest row restarts extended placement, or a tetrimino kicked up
+          // by a rotation could fall back and be moved again forever
+          if (game.active_tetrimino.pivot.row > extended_placement_row)
+            extended_placement_active = false;
+        }
+
+        // Below 1G each drop restarts the count; above it, fractions of a row add up
+        // from frame to frame for as long as the tetrimino keeps falling
+        if (!fell || game.get_gravity() < game::GRAVITY_ONE)
+          last_drop = frame;
+      }
+    }
+
+    // Check for mino landing
+    if (game.active_tetrimino.is_landed(game.playfield))
+    {
+      // Initialize extended placement mode
+      if (!extended_placement_active)
+      {
+        extended_placement_start = frame;
+        extended_placement_moves = 0;
+        extended_placement_row = game.active_tetrimino.pivot.row;
+        extended_placement_active = true;
+      }
+
+      // If tetrimino may no longer be manipulated
+      if (hard_drop
+          || (settings.gravity
+              && frame - extended_placement_start > EXTENDED_PLACEMENT_MAX_FRAMES))
+      {
+        short fewest_inputs = check_finesse
+          ? get_fewest_inputs(game.active_tetrimino, game.playfield)
+          : -1;
+        game.lock_active_tetrimino();
+        rows_cleared = game.clear_rows();
+        stats.piece_locked(rows_cleared, fewest_inputs, hard_drop);
+        game.draw_new_tetrimino();
+        events |= StepEvent::LOCKED;
+
+        // Reset placement control
+        extended_placement_active = false;
+        hard_drop = false;
+
+        if (game.is_game_over())
+        {
+          over = true;
+          end_type = EndType::GAME_OVER;
+          events |= StepEvent::ENDED;
+        }
+      }
+    }
+  }
+
+  if (!paused)
+    stats.next_frame();
+
+  ++frame;
+  return events;
+}
+
+short Session::step(Command command)
+{
+  short events = apply(command);
+  return events | advance();
+}
+
+short Session::step_frames(long frames)
+{
+  short events = StepEvent::NONE;
+  for (long i=0; i<frames && !over; i++)
+    events |= advance();
+
+  return events;
+}
+
+long Session::frames_until_deadline() const
+{
+  if (over || paused)
+    return NO_DEADLINE;
+
+  bool landed = game.active_tetrimino.is_landed(game.playfield);
+  if (landed && hard_drop)
+    return 0;
+
+  if (!settings.gravity)
+    return NO_DEADLINE;
+
+  // Next gravity drop; from 1G on the tetrimino falls every frame
+  std::int32_t gravity = game.get_gravity();
+  long deadline = 0;
+  if (gravity < game::GRAVITY_ONE)
+    deadline = std::max(0L, last_drop + (game::GRAVITY_ONE + gravity - 1) / gravity - frame);
+
+  // Lock at the end of extended placement, which starts now if it has not already
+  if (landed)
+  {
+    long start = extended_placement_active ? extended_placement_start : frame;
+    long lock = std::max(0L, start + EXTENDED_PLACEMENT_MAX_FRAMES + 1 - frame);
+    deadline = std::min(deadline, lock);
+  }
+
+  return deadline;
+}
+
+short Session::add_garbage(short rows, short hole_col)
+{
+  if (over)
+    return StepEvent::ENDED;
+
+  // Topping out, or being pushed into the active tetrimino, ends the game
+  if (game.add_garbage(rows, hole_col) || game.is_game_over())
+  {
+    over = true;
+    end_type = EndType::GAME_OVER;
+    return StepEvent::ENDED;
+  }
+
+  return StepEvent::NONE;
+}
+
+bool Session::is_over() const
+{
+  return over;
+}
+
+stats::Summary Session::stats_summary() const
+{
+  return stats.summary(TICK_DURATION.count());
+}
+
+GameResult Session::result() const
+{
+  return GameResult(end_type, game.level, game.score, stats_summary());
+}
+
@@ -0,0 +1,188 @@
+#ifndef TETRIS_SESSION_HPP
+#define TETRIS_SESSION_HPP
+
+#include "tetris_game.hpp"
+#include "tetris_stats.hpp"
+#include <chrono>
+#include <cstdint>
+
+namespace tetris
+{
+  namespace session
+  {
+    /* Enum to identify user game commands. */
+    enum class Command
+    {
+      DO_NOTHING,
+      PAUSE,
+      QUIT,
+      RESTART,
+      SHIFT_LEFT,
+      SHIFT_RIGHT,
+      ROTATE_CCW,
+      ROTATE_CW,
+      SOFT_DROP,
+      HARD_DROP,
+      HOLD,
+    };
+
+    /* Enum to identify how a game ended */
+    enum class EndType
+    {
+      GAME_OVER,
+      QUIT,
+      RESTART,
+    };
+
+    /* Struct for game settings */
+    struct GameSettings
+    {
+      bool gravity;
+      short preview_size;
+      std::uint64_t seed;
+    };
+
+    /* Struct for all results of a game */
+    struct GameResult
+    {
+      EndType end_type;
+      short end_level;
+      long end_score;
+      stats::Summary stats;
+
+      GameResult();
+
+      GameResult(EndType end_type_init,
+                 short end_level_init,
+                 long end_score_init,
+                 const stats::Summary& stats_init);
+    };
+
+    /* Bitmask to identify what happened during a step of a session. */
+    namespace StepEvent
+    {
+      const short NONE   = 0;
+      const short MOVED  = 1<<0; // Active tetrimino moved or rotated
+      const short LOCKED = 1<<1; // Active tetrimino locked and a new one was drawn
+      const short PAUSE  = 1<<2; // Session was paused or unpaused
+      const short ENDED  = 1<<3; // Session is over
+      const short HELD   = 1<<4; // Active tetrimino was swapped with the held tetrimino
+    }
+
+    /* Length of each game tick. */
+    const std::chrono::duration<float> TICK_DURATION(1.0/60.0);
+
+    /* Maximum number of moves permitted in extended placement mode. */
+    const short EXTENDED_PLACEMENT_MAX_MOVES = 15;
+
+    /* Extended placement timer duration. */
+    const std::chrono::duration<float> EXTENDED_PLACEMENT_MAX_TIME(0.5);
+
+    /* Whole frames that must pass beyond EXTENDED_PLACEMENT_MAX_TIME before a landed
+     * tetrimino locks; 30 frames at TICK_DURATION are exactly the limit.
+     */
+    const long EXTENDED_PLACEMENT_MAX_FRAMES = 30;
+
+    /* Returned by Session::frames_until_deadline when only a command can change the session. */
+    const long NO_DEADLINE = -1;
+
+    /* A single game, advanced one frame at a time.
+     *
+     * Holds the game state together with the placement and timing control that decide
+     * when tetriminoes fall and lock. Time is measured in frames of TICK_DURATION rather
+     * than read from a clock, so a session can be stepped as fast as the caller likes and
+     * does not depend on a terminal.
+     */
+    struct Session
+    {
+      GameSettings settings;
+      game::Game game;
+      long frame = 0;
+      bool paused = false;
+      bool over = false;
+      EndType end_type = EndType::GAME_OVER;
+
+      // Placement control
+      bool extended_placement_active = false;
+      long extended_placement_start = 0;
+      short extended_placement_moves = 0;
+      short extended_placement_row = 0; // Lowest row the pivot has landed on
+      bool hard_drop = false;
+
+      // Time control
+      long last_drop = 0;
+
+      short rows_cleared = 0; // By the most recent lock
+
+      // Player performance; checking finesse runs a move search at every lock
+      stats::PlayerStats stats;
+      bool check_finesse = false;
+
+      /* Create a session whose bag is seeded with settings.seed. */
+      Session(const GameSettings& settings_init);
+
+      /* Execute a command during the current frame, without advancing time.
+       *
+       * command[in]: Command to execute.
+       * repeat[in]: Whether it is an auto-repeat of a held shift key, which is not counted
+       *             as another action or input since the key was only pressed once.
+       *
+       * return: StepEvent bitmask.
+       */
+      short apply(Command command, bool repeat=false);
+
+      /* Process gravity and locking for the current frame, then move to the next one.
+       *
+       * return: StepEvent bitmask.
+       */
+      short advance();
+
+      /* Execute a command and advance by one frame.
+       *
+       * command[in]: Command to execute.
+       *
+       * return: StepEvent bitmask.
+       */
+      short step(Command command);
+
+      /* Advance by several frames without input, stopping early if the session ends.
+       *
+       * frames[in]: Number of frames to advance.
+       *
+       * return: StepEvent bitmask, combined over all frames.
+       */
+      short step_frames(long frames);
+
+      /* Get how many frames can pass before advance() may next change the game.
+       *
+       * The advance() at frame + the returned count is the earliest one that can drop or
+       * lock the active tetrimino; all advances before it only move time forward. Callers
+       * that are idle until then can sleep and catch up with step_frames() afterwards.
+       *
+       * return: Number of frames, or NO_DEADLINE if the session is paused, over, or will
+       *         not change without a command.
+       */
+      long frames_until_deadline() const;
+
+      /* Add garbage rows sent by an opponent, ending the session if it tops out.
+       *
+       * rows[in]: Number of garbage rows.
+       * hole_col[in]: Column left empty in every garbage row.
+       *
+       * return: StepEvent bitmask.
+       */
+      short add_garbage(short rows, short hole_col);
+
+      /* Check whether the session has ended. */
+      bool is_over() const;
+
+      /* Get the player's performance so far. */
+      stats::Summary stats_summary() const;
+
+      /* Get the results of the session so far. */
+      GameResult result() const;
+    };
+  }
+}
+
+#endif
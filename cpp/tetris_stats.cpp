@@ -0,0 +1,113 @@
+#include "tetris_stats.hpp"
+#include <algorithm>
+
+
+using namespace tetris;
+using namespace tetris::stats;
+
+
+namespace
+{
+  /* Get a rate per second of a count over some frames, or 0 before any frame passed. */
+  float rate(long count, long frames, float frame_seconds)
+  {
+    return frames > 0 ? count / (frames * frame_seconds) : 0;
+  }
+}
+
+
+/* RollingCount Class Methods */
+
+void RollingCount::add(long count)
+{
+  buckets[frames / BUCKET_FRAMES % WINDOW_BUCKETS] += count;
+  total += count;
+}
+
+void RollingCount::next_frame()
+{
+  ++frames;
+  if (frames % BUCKET_FRAMES != 0)
+    return;
+
+  long& oldest = buckets[frames / BUCKET_FRAMES % WINDOW_BUCKETS];
+  total -= oldest;
+  oldest = 0;
+}
+
+long RollingCount::window_frames() const
+{
+  long first_bucket = std::max(0L, frames / BUCKET_FRAMES - WINDOW_BUCKETS + 1);
+  return frames - first_bucket * BUCKET_FRAMES;
+}
+
+
+/* PlayerStats Class Methods */
+
+void PlayerStats::next_frame()
+{
+  ++frames;
+  recent_pieces.next_frame();
+  recent_actions.next_frame();
+}
+
+void PlayerStats::action()
+{
+  ++actions;
+  recent_actions.add();
+}
+
+void PlayerStats::input(bool soft_drop)
+{
+  if (!soft_drop || !soft_dropping)
+    ++piece_inputs;
+  soft_dropping = soft_drop;
+}
+
+void PlayerStats::piece_locked(short rows_cleared, short fewest_inputs, bool hard_dropped)
+{
+  ++pieces;
+  recent_pieces.add();
+  lines += rows_cleared;
+
+  // Waiting for the lock takes the place of the hard drop the fewest inputs end with
+  if (!hard_dropped)
+    ++piece_inputs;
+
+  if (fewest_inputs >= 0 && piece_inputs > fewest_inputs)
+  {
+    ++finesse_faults;
+    extra_inputs += piece_inputs - fewest_inputs;
+  }
+
+  piece_inputs = 0;
+  soft_dropping = false;
+}
+
+void PlayerStats::piece_held()
+{
+  piece_inputs = 0;
+  soft_dropping = false;
+}
+
+Summary PlayerStats::summary(float frame_seconds) const
+{
+  Summary result;
+  result.frames = frames;
+  result.pieces = pieces;
+  result.actions = actions;
+  result.lines = lines;
+  result.finesse_faults = finesse_faults;
+  result.extra_inputs = extra_inputs;
+
+  result.pieces_per_second = rate(pieces, frames, frame_seconds);
+  result.actions_per_minute = 60 * rate(actions, frames, frame_seconds);
+  result.lines_per_piece = pieces > 0 ? (float)lines / pieces : 0;
+
+  result.recent_pieces_per_second = rate(recent_pieces.total, recent_pieces.window_frames(),
+                                         frame_seconds);
+  result.recent_actions_per_minute = 60 * rate(recent_actions.total,
+                                               recent_actions.window_frames(),
+                                               frame_seconds);
+  return result;
+}
@@ -0,0 +1,112 @@
+#ifndef TETRIS_STATS_HPP
+#define TETRIS_STATS_HPP
+
+#include <array>
+
+namespace tetris
+{
+  namespace stats
+  {
+    /* Frames in each bucket of a rolling window: one second of game ticks. */
+    const long BUCKET_FRAMES = 60;
+
+    /* Buckets in a rolling window, so it covers the last minute of play. */
+    const short WINDOW_BUCKETS = 60;
+
+    /* Count of events over the most recent frames.
+     *
+     * Events are added to per-second buckets in a ring, and the bucket that falls out of
+     * the window is subtracted from a running total as a new one starts, so adding an
+     * event, moving to the next frame and reading the total all take constant time.
+     */
+    struct RollingCount
+    {
+      std::array<long, WINDOW_BUCKETS> buckets{};
+      long total = 0;  // Sum of every bucket
+      long frames = 0; // Frames passed since counting started
+
+      /* Add events to the current frame. */
+      void add(long count=1);
+
+      /* Move to the next frame, emptying the oldest bucket when a new one starts. */
+      void next_frame();
+
+      /* Get the number of frames the total covers: every frame in the window's buckets
+       * that has passed.
+       */
+      long window_frames() const;
+    };
+
+    /* Performance figures of a player, at the end of a game or during one. */
+    struct Summary
+    {
+      long frames = 0;         // Unpaused frames played
+      long pieces = 0;         // Tetriminoes locked
+      long actions = 0;        // Commands sent, a held shift key once, moved or not
+      long lines = 0;          // Rows cleared
+      long finesse_faults = 0; // Tetriminoes placed with more inputs than needed
+      long extra_inputs = 0;   // Inputs beyond the fewest needed, over every fault
+      float pieces_per_second = 0;
+      float actions_per_minute = 0;
+      float lines_per_piece = 0;
+      float recent_pieces_per_second = 0;  // Over the last minute
+      float recent_actions_per_minute = 0; // Over the last minute
+    };
+
+    /* Running counts behind a Summary, updated as a session is played.
+     *
+     * Time only counts while the game is not paused. For finesse, an input is a command
+     * that moved the active tetrimino, with a run of soft drops counting as one. A held
+     * shift key counts once however often it repeats, and a lock by the lock delay
+     * counts as the hard drop it stands in for.
+     */
+    struct PlayerStats
+    {
+      long frames = 0;
+      long pieces = 0;
+      long actions = 0;
+      long lines = 0;
+      long finesse_faults = 0;
+      long extra_inputs = 0;
+      RollingCount recent_pieces;
+      RollingCount recent_actions;
+
+      // Active tetrimino
+      short piece_inputs = 0;
+      bool soft_dropping = false; // Last input was a soft drop
+
+      /* Count one unpaused frame. */
+      void next_frame();
+
+      /* Count a game command sent by the player. */
+      void action();
+
+      /* Count a command that moved the active tetrimino.
+       *
+       * soft_drop[in]: Whether it was a soft drop, which continues a run of soft drops.
+       */
+      void input(bool soft_drop);
+
+      /* Count a locked tetrimino and start on the next one.
+       *
+       * rows_cleared[in]: Rows cleared by the lock.
+       * fewest_inputs[in]: Fewest inputs that could have placed the tetrimino, ending
+       *                    with a hard drop, or -1 if unknown, in which case finesse is
+       *                    not judged.
+       * hard_dropped[in]: Whether a hard drop locked it, rather than the lock delay.
+       */
+      void piece_locked(short rows_cleared, short fewest_inputs, bool hard_dropped);
+
+      /* Start on a tetrimino swapped in by hold. */
+      void piece_held();
+
+      /* Get the figures so far.
+       *
+       * frame_seconds[in]: Length of a frame in seconds.
+       */
+      Summary summary(float frame_seconds) const;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,43 @@
+#include "tetris_table.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+
+using namespace tetris;
+using namespace tetris::table;
+
+
+/* TranspositionTable Class Methods */
+
+TranspositionTable::TranspositionTable(short size_bits)
+  : entries(std::make_unique<Entry[]>(1ULL << size_bits)),
+    mask((1ULL << size_bits) - 1)
+{}
+
+bool TranspositionTable::probe(std::uint64_t key, std::uint64_t& data) const
+{
+  const Entry& entry = entries[key & mask];
+  std::uint64_t entry_data = entry.data.load(std::memory_order_relaxed);
+  if ((entry.check.load(std::memory_order_relaxed) ^ entry_data) != key)
+    return false;
+
+  data = entry_data;
+  return true;
+}
+
+void TranspositionTable::store(std::uint64_t key, std::uint64_t data)
+{
+  Entry& entry = entries[key & mask];
+  entry.check.store(key ^ data, std::memory_order_relaxed);
+  entry.data.store(data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::clear()
+{
+  for (std::uint64_t i=0; i<=mask; i++)
+  {
+    entries[i].check.store(0, std::memory_order_relaxed);
+    entries[i].data.store(0, std::memory_order_relaxed);
+  }
+}
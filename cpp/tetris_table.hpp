@@ -0,0 +1,59 @@
+#ifndef TETRIS_TABLE_HPP
+#define TETRIS_TABLE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace tetris
+{
+  namespace table
+  {
+    /* One slot of a TranspositionTable.
+     *
+     * check holds the key XORed with data, so a slot torn by two concurrent stores no
+     * longer matches either key and reads as a miss.
+     */
+    struct Entry
+    {
+      std::atomic<std::uint64_t> check{0};
+      std::atomic<std::uint64_t> data{0};
+    };
+
+    /* Fixed-size hash table of 64-bit data keyed by 64-bit position hashes.
+     *
+     * Any number of threads may probe and store concurrently without locking. Each key
+     * maps to a single slot and a store always replaces what was there, so the table
+     * forgets entries rather than growing; a probe only ever returns data that was stored
+     * under the same key. Empty slots read as data 0 stored under key 0.
+     */
+    struct TranspositionTable
+    {
+      std::unique_ptr<Entry[]> entries;
+      std::uint64_t mask;
+
+      /* Create an empty table.
+       *
+       * size_bits[in]: Base 2 logarithm of the number of slots.
+       */
+      TranspositionTable(short size_bits);
+
+      /* Look up the data stored under a key.
+       *
+       * key[in]: Key to look up.
+       * data[out]: Data stored under the key, if found.
+       *
+       * return: Whether the key was found.
+       */
+      bool probe(std::uint64_t key, std::uint64_t& data) const;
+
+      /* Store data under a key, replacing whatever was in its slot. */
+      void store(std::uint64_t key, std::uint64_t data);
+
+      /* Forget every entry. Not safe to call while other threads use the table. */
+      void clear();
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include "tetris_timing.hpp"
+#include "tetris_session.hpp"
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+
+
+using namespace tetris;
+using namespace tetris::timing;
+
+
+namespace
+{
+  const std::chrono::duration<double> TICK(session::TICK_DURATION);
+
+  std::chrono::steady_clock::duration frames_to_duration(long frames)
+  {
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(frames * TICK);
+  }
+}
+
+
+/* RealClock Class Methods */
+
+void RealClock::start(long frame)
+{
+  game_start = std::chrono::steady_clock::now() - frames_to_duration(frame);
+}
+
+long RealClock::frames_passed() const
+{
+  return (std::chrono::steady_clock::now() - game_start) / TICK;
+}
+
+void RealClock::sleep_until(long frame)
+{
+  std::chrono::steady_clock::time_point wake_time = real_time(frame);
+  wait_for_input(&wake_time);
+}
+
+std::chrono::steady_clock::time_point RealClock::real_time(long frame) const
+{
+  return game_start + frames_to_duration(frame);
+}
+
+
+/* VirtualClock Class Methods */
+
+void VirtualClock::start(long frame_init)
+{
+  frame = frame_init;
+}
+
+long VirtualClock::frames_passed() const
+{
+  return frame;
+}
+
+void VirtualClock::sleep_until(long frame_until)
+{
+  frame = std::max(frame, frame_until);
+}
+
+std::chrono::steady_clock::time_point VirtualClock::real_time(long) const
+{
+  return std::chrono::steady_clock::time_point::max();
+}
+
+
+/* Free Functions */
+
+void tetris::timing::wait_for_input(const std::chrono::steady_clock::time_point* wake_time)
+{
+  pollfd stdin_poll{STDIN_FILENO, POLLIN, 0};
+
+  if (!wake_time)
+  {
+    ppoll(&stdin_poll, 1, nullptr, nullptr);
+    return;
+  }
+
+  std::chrono::nanoseconds wait = *wake_time - std::chrono::steady_clock::now();
+  if (wait <= std::chrono::nanoseconds::zero())
+    return;
+
+  timespec timeout;
+  timeout.tv_sec = wait.count() / 1000000000;
+  timeout.tv_nsec = wait.count() % 1000000000;
+  ppoll(&stdin_poll, 1, &timeout, nullptr);
+}
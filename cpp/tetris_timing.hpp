@@ -0,0 +1,70 @@
+#ifndef TETRIS_TIMING_HPP
+#define TETRIS_TIMING_HPP
+
+#include <chrono>
+
+namespace tetris
+{
+  namespace timing
+  {
+    /* Source of time for an interactive game loop.
+     *
+     * Time is counted in frames of session::TICK_DURATION since the game started, so the
+     * loop only ever compares whole frames and a session plays the same whichever clock
+     * drives it.
+     */
+    struct Clock
+    {
+      virtual ~Clock() = default;
+
+      /* Start counting time as though frame frames had already passed, e.g. when resuming
+       * a saved session.
+       */
+      virtual void start(long frame) = 0;
+
+      /* Get the number of frames that have passed, i.e. that are due to be advanced. */
+      virtual long frames_passed() const = 0;
+
+      /* Sleep until frame frames have passed, waking early if a key is pressed. */
+      virtual void sleep_until(long frame) = 0;
+
+      /* Get the real time at which frame frames will have passed, for latency profiling,
+       * or time_point::max() if the clock does not follow real time.
+       */
+      virtual std::chrono::steady_clock::time_point real_time(long frame) const = 0;
+    };
+
+    /* Clock following the steady clock, for games played by people. */
+    struct RealClock : Clock
+    {
+      std::chrono::steady_clock::time_point game_start;
+
+      void start(long frame) override;
+      long frames_passed() const override;
+      void sleep_until(long frame) override;
+      std::chrono::steady_clock::time_point real_time(long frame) const override;
+    };
+
+    /* Clock that only moves when it is slept on, jumping straight to the frame being waited
+     * for. A game loop driven by it runs as fast as it can draw and decide, and plays the
+     * same frames every run.
+     */
+    struct VirtualClock : Clock
+    {
+      long frame = 0;
+
+      void start(long frame_init) override;
+      long frames_passed() const override;
+      void sleep_until(long frame_until) override;
+      std::chrono::steady_clock::time_point real_time(long frame) const override;
+    };
+
+    /* Sleep until a key is pressed, or until a given time
+     *
+     * wake_time[in]: Time to stop waiting, or null to wait for a key indefinitely.
+     */
+    void wait_for_input(const std::chrono::steady_clock::time_point* wake_time=nullptr);
+  }
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "tetris_ui.hpp"
 #include "tetris_game.hpp"
+#include "tetris_stats.hpp"
 #include <ncurses.h>
 #include <algorithm>
 #include <array>
@@ -15,12 +16,56 @@ using namespace tetris;
 using namespace tetris::ui;
 
 
-WINDOW *tetris::ui::play_window, *tetris::ui::preview_window, *tetris::ui::score_window;
+WINDOW *tetris::ui::play_window, *tetris::ui::preview_window, *tetris::ui::score_window,
+  *tetris::ui::hold_window;
+
+
+namespace
+{
+  /* Cell value that never occurs in a built frame, marking a cell as needing a repaint */
+  const ui::Cell STALE_CELL = 0xFF;
+
+  /* What is currently on screen, so redraws can skip unchanged cells and values */
+  ui::Frame drawn_frame;
+  long drawn_score = -1;
+  short drawn_rows = -1;
+  short drawn_level = -1;
+  float drawn_pieces_per_second = -1;
+  float drawn_actions_per_minute = -1;
+  float drawn_lines_per_piece = -1;
+  long drawn_finesse_faults = -1;
+
+  /* Paint one cell of the play window */
+  void draw_cell(short row, short col, ui::Cell cell)
+  {
+    game::Point window_coords = ui::playfield_point_to_draw_window_point(game::Point(row, col));
+    wmove(play_window, window_coords.row, window_coords.col);
+
+    // If no mino is present, draw guide dot
+    if (cell == ui::CellLayer::NONE)
+    {
+      waddstr(play_window, ". ");
+      return;
+    }
+
+    short layer = cell & ~7;
+    short type = cell & 7;
+    short color = layer == ui::CellLayer::GHOST ? ui::GHOST_COLOR[type] : ui::MINO_COLOR[type];
+    wattron(play_window, COLOR_PAIR(color));
+    if (layer == ui::CellLayer::GHOST)
+      waddwstr(play_window, L"[]");
+    else if (layer == ui::CellLayer::ACTIVE)
+      waddwstr(play_window, L"..");
+    else
+      waddstr(play_window, "  ");
+    wattroff(play_window, COLOR_PAIR(color));
+  }
+}
 
 
 game::Point tetris::ui::playfield_point_to_draw_window_point(const game::Point& point)
 {
-  return game::Point(1+point.row-19, 1+point.col*2);
+  return game::Point(1+point.row-game::Playfield::FIRST_VISIBLE_ROW, 1+point.col*2);
 }
 
 WINDOW* tetris::ui::create_window(const WindowInfo& window_info)
@@ -42,23 +87,26 @@ void tetris::ui::init_ui(short preview_size)
   keypad(stdscr, true);
   setlocale(LC_ALL, "");
 
+  // Keys are read with read() while drawing, so never let pending input cut an update short
+  typeahead(-1);
+
   // Initialize colors, with tetromino types as keys
   start_color();
   use_default_colors();
-  init_pair(MINO_COLOR.at(game::TetriminoType::O), COLOR_WHITE, COLOR_WHITE);
-  init_pair(MINO_COLOR.at(game::TetriminoType::I), COLOR_CYAN, COLOR_CYAN);
-  init_pair(MINO_COLOR.at(game::TetriminoType::T), COLOR_MAGENTA, COLOR_MAGENTA);
-  init_pair(MINO_COLOR.at(game::TetriminoType::L), COLOR_YELLOW, COLOR_YELLOW);
-  init_pair(MINO_COLOR.at(game::TetriminoType::J), COLOR_BLUE, COLOR_BLUE);
-  init_pair(MINO_COLOR.at(game::TetriminoType::S), COLOR_GREEN, COLOR_GREEN);
-  init_pair(MINO_COLOR.at(game::TetriminoType::Z), COLOR_RED, COLOR_RED);
-  init_pair(GHOST_COLOR.at(game::TetriminoType::O), COLOR_WHITE, 0);
-  init_pair(GHOST_COLOR.at(game::TetriminoType::I), COLOR_CYAN, 0);
-  init_pair(GHOST_COLOR.at(game::TetriminoType::T), COLOR_MAGENTA, 0);
-  init_pair(GHOST_COLOR.at(game::TetriminoType::L), COLOR_YELLOW, 0);
-  init_pair(GHOST_COLOR.at(game::TetriminoType::J), COLOR_BLUE, 0);
-  init_pair(GHOST_COLOR.at(game::TetriminoType::S), COLOR_GREEN, 0);
-  init_pair(GHOST_COLOR.at(game::TetriminoType::Z), COLOR_RED, 0);
+  init_pair(MINO_COLOR[(short)game::TetriminoType::O], COLOR_WHITE, COLOR_WHITE);
+  init_pair(MINO_COLOR[(short)game::TetriminoType::I], COLOR_CYAN, COLOR_CYAN);
+  init_pair(MINO_COLOR[(short)game::TetriminoType::T], COLOR_MAGENTA, COLOR_MAGENTA);
+  init_pair(MINO_COLOR[(short)game::TetriminoType::L], COLOR_YELLOW, COLOR_YELLOW);
+  init_pair(MINO_COLOR[(short)game::TetriminoType::J], COLOR_BLUE, COLOR_BLUE);
+  init_pair(MINO_COLOR[(short)game::TetriminoType::S], COLOR_GREEN, COLOR_GREEN);
+  init_pair(MINO_COLOR[(short)game::TetriminoType::Z], COLOR_RED, COLOR_RED);
+  init_pair(GHOST_COLOR[(short)game::TetriminoType::O], COLOR_WHITE, 0);
+  init_pair(GHOST_COLOR[(short)game::TetriminoType::I], COLOR_CYAN, 0);
+  init_pair(GHOST_COLOR[(short)game::TetriminoType::T], COLOR_MAGENTA, 0);
+  init_pair(GHOST_COLOR[(short)game::TetriminoType::L], COLOR_YELLOW, 0);
+  init_pair(GHOST_COLOR[(short)game::TetriminoType::J], COLOR_BLUE, 0);
+  init_pair(GHOST_COLOR[(short)game::TetriminoType::S], COLOR_GREEN, 0);
+  init_pair(GHOST_COLOR[(short)game::TetriminoType::Z], COLOR_RED, 0);
 
   // Calculate actual preview window info from base
   WindowInfo preview_window_info(PREVIEW_WINDOW_INFO);
@@ -68,76 +116,118 @@ void tetris::ui::init_ui(short preview_size)
   play_window = create_window(PLAY_WINDOW_INFO);
   preview_window = create_window(preview_window_info);
   score_window = create_window(SCORE_WINDOW_INFO);
+  hold_window = create_window(HOLD_WINDOW_INFO);
   box(play_window, 0, 0);
   box(preview_window, 0, 0);
   box(score_window, 0, 0);
+  box(hold_window, 0, 0);
   refresh();
   wrefresh(play_window);
   wrefresh(preview_window);
   wrefresh(score_window);
+  wrefresh(hold_window);
+
+  invalidate_frame();
 }
 
-void tetris::ui::redraw_playfield(const game::Playfield& playfield, const game::Tetrimino& active_tetrimino)
+void tetris::ui::invalidate_frame()
 {
-  // Draw playfield
-  for (int i=19; i<40; i++)
-  {
-    for (int j=0; j<10; j++)
-    {
-      game::Point window_coords = playfield_point_to_draw_window_point(game::Point(i, j));
-      wmove(play_window, window_coords.row, window_coords.col);
-      // If no mino is present, draw guide dot
-      if (playfield[i][j] == game::TetriminoType::NONE)
-      {
-        waddstr(play_window, ". ");
-      }
-      // Otherwise, draw block
-      else
-      {
-        wattron(play_window, COLOR_PAIR(MINO_COLOR.at(playfield[i][j])));
-        waddstr(play_window, "  ");
-        wattroff(play_window, COLOR_PAIR(MINO_COLOR.at(playfield[i][j])));
-      }
-    }
-  }
+  for (std::array<Cell, game::Playfield::WIDTH>& row : drawn_frame)
+    row.fill(STALE_CELL);
+}
 
-  // Draw ghost at landing
-  wattron(play_window, COLOR_PAIR(GHOST_COLOR.at(active_tetrimino.type)));
-  for (game::Point p : active_tetrimino.get_landing(playfield).points)
-  {
-    if (p.row >= 19)
-    {
-      game::Point window_coords = playfield_point_to_draw_window_point(p);
-      mvwaddwstr(play_window, window_coords.row, window_coords.col, L"[]");
-    }
-  }
-  wattroff(play_window, COLOR_PAIR(GHOST_COLOR.at(active_tetrimino.type)));
+void tetris::ui::build_frame(const game::Playfield& playfield,
+                             const game::Tetrimino& active_tetrimino,
+                             Frame& frame)
+{
+  const short first_row = game::Playfield::FIRST_VISIBLE_ROW;
+  for (short i=first_row; i<game::Playfield::HEIGHT; i++)
+    for (short j=0; j<game::Playfield::WIDTH; j++)
+      frame[i-first_row][j] = CellLayer::LOCKED + (Cell)playfield[i][j];
+
+  for (const game::Point& p : active_tetrimino.get_landing(playfield).points)
+    if (p.row >= first_row)
+      frame[p.row-first_row][p.col] = CellLayer::GHOST + (Cell)active_tetrimino.type;
+
+  for (const game::Point& p : active_tetrimino.points)
+    if (p.row >= first_row)
+      frame[p.row-first_row][p.col] = CellLayer::ACTIVE + (Cell)active_tetrimino.type;
+}
 
-  // Draw active tetrimino
-  wattron(play_window, COLOR_PAIR(MINO_COLOR.at(active_tetrimino.type)));
-  for (game::Point p : active_tetrimino.points)
+void tetris::ui::redraw_frame(const Frame& frame)
+{
+  // Paint only the cells that differ from what is on screen
+  bool changed = false;
+  for (short i=0; i<game::Playfield::VISIBLE_ROWS; i++)
   {
-    if (p.row >= 19)
+    for (short j=0; j<game::Playfield::WIDTH; j++)
     {
-      game::Point window_coords = playfield_point_to_draw_window_point(p);
-      mvwaddwstr(play_window, window_coords.row, window_coords.col, L"..");
+      if (frame[i][j] == drawn_frame[i][j])
+        continue;
+
+      draw_cell(i+game::Playfield::FIRST_VISIBLE_ROW, j, frame[i][j]);
+      drawn_frame[i][j] = frame[i][j];
+      changed = true;
     }
   }
-  wattroff(play_window, COLOR_PAIR(MINO_COLOR.at(active_tetrimino.type)));
 
-  wrefresh(play_window);
+  if (changed)
+    wnoutrefresh(play_window);
 }
 
-void tetris::ui::redraw_score(long score, short rows, short level)
+void tetris::ui::redraw_score(long score, short rows, short level, const stats::Summary& summary)
 {
+  if (score == drawn_score && rows == drawn_rows && level == drawn_level
+      && summary.recent_pieces_per_second == drawn_pieces_per_second
+      && summary.recent_actions_per_minute == drawn_actions_per_minute
+      && summary.lines_per_piece == drawn_lines_per_piece
+      && summary.finesse_faults == drawn_finesse_faults)
+    return;
+
   mvwprintw(score_window, 1, 2, "Score: %-8ld", score);
   mvwprintw(score_window, 2, 2, "Rows:  %-8hd", rows);
   mvwprintw(score_window, 3, 2, "Level: %-8hd", level);
-  wrefresh(score_window);
+  mvwprintw(score_window, 5, 2, "PPS:   %-8.2f", summary.recent_pieces_per_second);
+  mvwprintw(score_window, 6, 2, "APM:   %-8.1f", summary.recent_actions_per_minute);
+  mvwprintw(score_window, 7, 2, "L/pc:  %-8.2f", summary.lines_per_piece);
+  mvwprintw(score_window, 8, 2, "Fault: %-8ld", summary.finesse_faults);
+  wnoutrefresh(score_window);
+
+  drawn_score = score;
+  drawn_rows = rows;
+  drawn_level = level;
+  drawn_pieces_per_second = summary.recent_pieces_per_second;
+  drawn_actions_per_minute = summary.recent_actions_per_minute;
+  drawn_lines_per_piece = summary.lines_per_piece;
+  drawn_finesse_faults = summary.finesse_faults;
 }
 
-void tetris::ui::redraw_preview(const std::deque<game::Tetrimino>& tetrimino_queue,
-                                short preview_size)
+void tetris::ui::redraw_hold(game::TetriminoType held_type)
+{
+  wclear(hold_window);
+  box(hold_window, 0, 0);
+
+  if (held_type != game::TetriminoType::NONE)
+  {
+    game::Tetrimino tetrimino(held_type);
+    game::Point draw_base{2, -4};
+
+    wattron(hold_window, COLOR_PAIR(MINO_COLOR[(short)tetrimino.type]));
+    for (game::Point tetrimino_point : tetrimino.points)
+    {
+      game::Point draw_point = draw_base + playfield_point_to_draw_window_point(tetrimino_point);
+      if (tetrimino.type == game::TetriminoType::I)
+        draw_point.row -= 1;
+
+      mvwaddwstr(hold_window, draw_point.row, draw_point.col, L"..");
+    }
+    wattroff(hold_window, COLOR_PAIR(MINO_COLOR[(short)tetrimino.type]));
+  }
+
+  wnoutrefresh(hold_window);
+}
+
+void tetris::ui::redraw_preview(const Preview& preview, short preview_size)
 {
   wclear(preview_window);
   box(preview_window, 0, 0);
@@ -146,9 +236,9 @@ void tetris::ui::redraw_preview(const std::deque<game::Tetrimino>& tetrimino_que
 
   for (int i=0; i<preview_size; i++)
   {
-    game::Tetrimino tetrimino = tetrimino_queue[i];
+    game::Tetrimino tetrimino(preview[i]);
 
-    wattron(preview_window, COLOR_PAIR(MINO_COLOR.at(tetrimino.type)));
+    wattron(preview_window, COLOR_PAIR(MINO_COLOR[(short)tetrimino.type]));
     for (game::Point tetrimino_point : tetrimino.points)
     {
       game::Point draw_point = draw_base + playfield_point_to_draw_window_point(tetrimino_point);
@@ -157,7 +247,7 @@ void tetris::ui::redraw_preview(const std::deque<game::Tetrimino>& tetrimino_que
 
       mvwaddwstr(preview_window, draw_point.row, draw_point.col, L"..");
     }
-    wattroff(preview_window, COLOR_PAIR(MINO_COLOR.at(tetrimino.type)));
+    wattroff(preview_window, COLOR_PAIR(MINO_COLOR[(short)tetrimino.type]));
 
     if (tetrimino.type == game::TetriminoType::I)
       draw_base += game::Point(2, 0);
@@ -165,7 +255,12 @@ void tetris::ui::redraw_preview(const std::deque<game::Tetrimino>& tetrimino_que
       draw_base += game::Point(3, 0);
   }
 
-  wrefresh(preview_window);
+  wnoutrefresh(preview_window);
+}
+
+void tetris::ui::present()
+{
+  doupdate();
 }
 
 void tetris::ui::redraw_window_text(WINDOW* window,
@@ -190,19 +285,20 @@ void tetris::ui::redraw_window_text(WINDOW* window,
 
 void tetris::ui::redraw_pause_screen()
 {
-  for (short i=19; i<40; i++)
+  for (short i=game::Playfield::FIRST_VISIBLE_ROW; i<game::Playfield::HEIGHT; i++)
   {
     game::Point window_coords = playfield_point_to_draw_window_point(game::Point(i, 0));
     mvwaddwstr(play_window, window_coords.row, window_coords.col, L"                    ");
   }
   redraw_window_text(play_window, PLAY_WINDOW_INFO, L"PAUSED");
+  invalidate_frame();
 
-  wrefresh(play_window);
+  wnoutrefresh(play_window);
 }
 
 void tetris::ui::redraw_game_over_screen()
 {
-  for (short i=19; i<40; i++)
+  for (short i=game::Playfield::FIRST_VISIBLE_ROW; i<game::Playfield::HEIGHT; i++)
   {
     game::Point window_coords = playfield_point_to_draw_window_point(game::Point(i, 0));
     mvwaddwstr(play_window, window_coords.row, window_coords.col, L"                    ");
@@ -214,6 +310,7 @@ void tetris::ui::redraw_game_over_screen()
                  << L"[r] Retry" << std::endl
                  << L"[q] Quit" << std::endl;
   redraw_window_text(play_window, PLAY_WINDOW_INFO, game_over_text.str());
+  invalidate_frame();
 
-  wrefresh(play_window);
+  wnoutrefresh(play_window);
 }
@@ -2,8 +2,10 @@
 #define TETRIS_UI_HPP
 
 #include "tetris_game.hpp"
+#include "tetris_stats.hpp"
 #include <ncurses.h>
-#include <queue>
+#include <array>
+#include <cstdint>
 #include <string>
 
 namespace tetris
@@ -26,14 +28,21 @@ namespace tetris
     /* Initialize the ncurses UI */
     void init_ui(short preview_size);
 
-    /* Redraw the playfield and then the active tetrimino over it */
-    void redraw_playfield(const game::Playfield& playfield, const game::Tetrimino& active_tetrimino);
+    /* Redraw the player's current score and level, and below them the recent pieces per
+     * second and actions per minute, lines per piece and finesse faults, if any have
+     * changed
+     */
+    void redraw_score(long score, short rows, short level, const stats::Summary& summary);
 
-    /* Redraw the player's current score and level */
-    void redraw_score(long score, short rows, short level);
+    /* Redraw the held tetrimino, or an empty hold box for TetriminoType::NONE */
+    void redraw_hold(game::TetriminoType held_type);
 
-    /* Redraw the preview of upcoming tetriminoes */
-    void redraw_preview(const std::deque<game::Tetrimino>& tetrimino_queue, short preview_size);
+    /* Write everything redrawn since the last call to the terminal at once.
+     *
+     * The redraw_* functions only update ncurses' picture of the screen, so one or more of
+     * them must be followed by present() before anything is shown.
+     */
+    void present();
 
     /* Redraw the given text in the center of the given window */
     void redraw_window_text(WINDOW* window,
@@ -50,32 +59,55 @@ namespace tetris
     /* Window info constants */
     const WindowInfo PLAY_WINDOW_INFO{23, 22, -11, -11};
     const WindowInfo PREVIEW_WINDOW_INFO{21, 14, -11, 13};
-    const WindowInfo SCORE_WINDOW_INFO{5, 20, -11, -33};
-
-    /* Map of (tetrimino type -> ncurses color code) for active and locked minoes */
-    const std::map<game::TetriminoType, short> MINO_COLOR{
-      {game::TetriminoType::O, 1},
-      {game::TetriminoType::I, 2},
-      {game::TetriminoType::T, 3},
-      {game::TetriminoType::L, 4},
-      {game::TetriminoType::J, 5},
-      {game::TetriminoType::S, 6},
-      {game::TetriminoType::Z, 7},
-    };
+    const WindowInfo SCORE_WINDOW_INFO{10, 20, -11, -33};
+    const WindowInfo HOLD_WINDOW_INFO{6, 14, -1, -27};
 
-    /* Map of (tetrimino type -> ncurses color code) for ghost minoes */
-    const std::map<game::TetriminoType, short> GHOST_COLOR{
-      {game::TetriminoType::O, 8},
-      {game::TetriminoType::I, 9},
-      {game::TetriminoType::T, 10},
-      {game::TetriminoType::L, 11},
-      {game::TetriminoType::J, 12},
-      {game::TetriminoType::S, 13},
-      {game::TetriminoType::Z, 14},
-    };
+    /* Table of (tetrimino type -> ncurses color code) for active and locked minoes */
+    const std::array<short, 8> MINO_COLOR{0, 1, 2, 3, 4, 5, 6, 7};
+
+    /* Table of (tetrimino type -> ncurses color code) for ghost minoes */
+    const std::array<short, 8> GHOST_COLOR{0, 8, 9, 10, 11, 12, 13, 14};
+
+    /* Contents of one drawn playfield cell: NONE, or a tetrimino type offset by its layer */
+    using Cell = std::uint8_t;
+    namespace CellLayer
+    {
+      const Cell NONE   = 0;
+      const Cell LOCKED = 0;
+      const Cell GHOST  = 8;
+      const Cell ACTIVE = 16;
+    }
+
+    /* Visible playfield rows (FIRST_VISIBLE_ROW to the floor) as last drawn to the play window */
+    using Frame = std::array<std::array<Cell, game::Playfield::WIDTH>, game::Playfield::VISIBLE_ROWS>;
+
+    /* Forget what was last drawn, so the next redraw repaints everything */
+    void invalidate_frame();
+
+    /* Build the frame of a playfield: locked minoes, then the ghost of the active
+     * tetrimino at its landing, then the active tetrimino over both.
+     */
+    void build_frame(const game::Playfield& playfield,
+                     const game::Tetrimino& active_tetrimino,
+                     Frame& frame);
+
+    /* Redraw the playfield from a built frame.
+     *
+     * Only cells that differ from the last drawn frame are repainted.
+     */
+    void redraw_frame(const Frame& frame);
+
+    /* Most tetriminoes the preview can show */
+    const short MAX_PREVIEW_SIZE = 6;
+
+    /* Types of the upcoming tetriminoes, next first */
+    using Preview = std::array<game::TetriminoType, MAX_PREVIEW_SIZE>;
+
+    /* Redraw the preview of upcoming tetriminoes */
+    void redraw_preview(const Preview& preview, short preview_size);
 
     /* Window pointer globals */
-    extern WINDOW *play_window, *preview_window, *score_window;
+    extern WINDOW *play_window, *preview_window, *score_window, *hold_window;
   }
 }
 
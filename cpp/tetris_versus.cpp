@@ -0,0 +1,209 @@
+#include "tetris_versus.hpp"
+#include "tetris_batch.hpp"
+#include "tetris_game.hpp"
+#include "tetris_pool.hpp"
+#include "tetris_session.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+using namespace tetris;
+using namespace tetris::versus;
+
+
+/* GarbageQueue Class Methods */
+
+bool GarbageQueue::push(const Attack& attack)
+{
+  std::uint32_t position = tail.load(std::memory_order_relaxed);
+  if (position - head.load(std::memory_order_acquire) == GARBAGE_QUEUE_CAPACITY)
+    return false;
+
+  slots[position % GARBAGE_QUEUE_CAPACITY] = attack;
+  tail.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+const Attack* GarbageQueue::front() const
+{
+  std::uint32_t position = head.load(std::memory_order_relaxed);
+  if (position == tail.load(std::memory_order_acquire))
+    return nullptr;
+
+  return &slots[position % GARBAGE_QUEUE_CAPACITY];
+}
+
+void GarbageQueue::pop()
+{
+  head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+
+/* Free Functions */
+
+BoardStats tetris::versus::play_board(const MatchSettings& settings,
+                                      std::uint64_t seed,
+                                      batch::Policy& policy,
+                                      Board& self,
+                                      Board& opponent)
+{
+  session::GameSettings game_settings = settings.game_settings;
+  game_settings.seed = seed;
+  session::Session session(game_settings);
+  const game::Game& game = session.game;
+  game::Random holes(batch::game_seed(seed, 1));
+
+  BoardStats stats{};
+  std::deque<short> arrived; // Garbage that has arrived but not been added yet
+  std::chrono::steady_clock::duration waited(0);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  while (!session.is_over()
+         && (settings.max_tetriminoes == 0 || game.total_tetriminoes_locked < settings.max_tetriminoes))
+  {
+    long frame = session.frame;
+
+    // Wait for the opponent to send everything that could arrive during this frame
+    if (opponent.frame.load(std::memory_order_acquire) <= frame - GARBAGE_DELAY
+        && !opponent.done.load(std::memory_order_acquire))
+    {
+      std::chrono::steady_clock::time_point wait_start = std::chrono::steady_clock::now();
+      while (opponent.frame.load(std::memory_order_acquire) <= frame - GARBAGE_DELAY
+             && !opponent.done.load(std::memory_order_acquire))
+        std::this_thread::yield();
+      waited += std::chrono::steady_clock::now() - wait_start;
+    }
+
+    // Play on only until the opponent's last garbage has landed
+    if (opponent.done.load(std::memory_order_acquire)
+        && frame >= opponent.frame.load(std::memory_order_relaxed) + GARBAGE_DELAY)
+      break;
+
+    for (const Attack* attack=self.incoming.front();
+         attack && attack->frame + GARBAGE_DELAY <= frame;
+         attack=self.incoming.front())
+    {
+      arrived.push_back(attack->rows);
+      self.incoming.pop();
+    }
+
+    short events = session.step(policy.next_command(session));
+    if (events & session::StepEvent::LOCKED)
+    {
+      short rows = GARBAGE_FOR_ROWS_CLEARED[std::min<short>(session.rows_cleared, 4)];
+
+      // Attacks cancel garbage that has arrived before any is sent on
+      while (rows > 0 && !arrived.empty())
+      {
+        short cancelled = std::min(rows, arrived.front());
+        rows -= cancelled;
+        arrived.front() -= cancelled;
+        if (arrived.front() == 0)
+          arrived.pop_front();
+      }
+
+      if (rows > 0)
+      {
+        // Once the opponent is done nothing reads the queue, so the attack is dropped
+        bool queued = opponent.incoming.push(Attack{frame, rows});
+        while (!queued && !opponent.done.load(std::memory_order_acquire))
+        {
+          std::this_thread::yield();
+          queued = opponent.incoming.push(Attack{frame, rows});
+        }
+        if (queued)
+          stats.garbage_sent += rows;
+      }
+      else if (session.rows_cleared == 0)
+      {
+        for (short garbage : arrived)
+        {
+          session.add_garbage(garbage, holes.below(game::Playfield::WIDTH));
+          stats.garbage_received += garbage;
+        }
+        arrived.clear();
+      }
+    }
+
+    self.frame.store(session.frame, std::memory_order_release);
+  }
+
+  self.frame.store(session.frame, std::memory_order_release);
+  self.done.store(true, std::memory_order_release);
+
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  stats.score = game.score;
+  stats.rows = game.total_rows_cleared;
+  stats.tetriminoes = game.total_tetriminoes_locked;
+  stats.frames = session.frame;
+  stats.topped_out = session.is_over() && session.end_type == session::EndType::GAME_OVER;
+  stats.seconds = std::chrono::duration<double>(end - start).count();
+  stats.wait_seconds = std::chrono::duration<double>(waited).count();
+  stats.search = policy.counters();
+  return stats;
+}
+
+MatchStats tetris::versus::play_match(const MatchSettings& settings,
+                                      std::uint64_t seed,
+                                      batch::Policy& first,
+                                      batch::Policy& second)
+{
+  std::array<Board, 2> boards;
+  MatchStats stats;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  std::thread second_thread([&] ()
+  {
+    stats.boards[1] = play_board(settings, seed, second, boards[1], boards[0]);
+  });
+  stats.boards[0] = play_board(settings, seed, first, boards[0], boards[1]);
+  second_thread.join();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  stats.seconds = elapsed.count();
+
+  const BoardStats& a = stats.boards[0];
+  const BoardStats& b = stats.boards[1];
+  if (a.topped_out && (!b.topped_out || b.frames > a.frames))
+    stats.winner = 1;
+  else if (b.topped_out && (!a.topped_out || a.frames > b.frames))
+    stats.winner = 0;
+  else
+    stats.winner = -1;
+
+  return stats;
+}
+
+VersusResult tetris::versus::run_matches(const VersusSettings& settings, const batch::PolicyFactory& make_policy)
+{
+  unsigned threads = settings.threads ? settings.threads : std::thread::hardware_concurrency();
+  pool::ThreadPool thread_pool(std::max(1U, threads / 2));
+
+  VersusResult result;
+  result.matches.resize(settings.matches);
+  result.threads = 2 * thread_pool.size();
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  thread_pool.parallel_for(
+    settings.matches,
+    [&] (long index, unsigned)
+    {
+      std::uint64_t seed = batch::game_seed(settings.seed, index);
+      std::unique_ptr<batch::Policy> first = make_policy(batch::game_seed(seed, 0));
+      std::unique_ptr<batch::Policy> second = make_policy(batch::game_seed(seed, 1));
+      result.matches[index] = play_match(settings.match_settings, seed, *first, *second);
+    });
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  result.seconds = elapsed.count();
+
+  return result;
+}
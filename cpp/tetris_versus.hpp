@@ -0,0 +1,164 @@
+#ifndef TETRIS_VERSUS_HPP
+#define TETRIS_VERSUS_HPP
+
+#include "tetris_batch.hpp"
+#include "tetris_session.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace tetris
+{
+  namespace versus
+  {
+    /* Garbage rows sent for clearing 0 to 4 rows with one lock. */
+    const std::array<short, 5> GARBAGE_FOR_ROWS_CLEARED{0, 0, 1, 2, 4};
+
+    /* Frames between garbage being sent and arriving. This is also how far either board
+     * may run ahead of the other.
+     */
+    const long GARBAGE_DELAY = 20;
+
+    /* Slots in each garbage queue; a power of two.
+     *
+     * A board locks at most once per frame and runs at most GARBAGE_DELAY frames ahead of
+     * the board reading its garbage, so fewer than 2 * GARBAGE_DELAY attacks are ever
+     * waiting.
+     */
+    const std::uint32_t GARBAGE_QUEUE_CAPACITY = 64;
+
+    /* Garbage sent by one lock */
+    struct Attack
+    {
+      long frame; // Frame of the sender's session in which it was sent
+      short rows;
+    };
+
+    /* Lock-free queue carrying attacks from one board's thread to the other's.
+     *
+     * Single producer, single consumer: each index is only written by one side, so a
+     * release store of it publishes the slots before it and nothing else is shared. The
+     * indices are kept on separate cache lines so the two threads do not contend.
+     */
+    struct GarbageQueue
+    {
+      std::array<Attack, GARBAGE_QUEUE_CAPACITY> slots;
+      alignas(64) std::atomic<std::uint32_t> head{0}; // Next slot to read; written by the consumer
+      alignas(64) std::atomic<std::uint32_t> tail{0}; // Next slot to write; written by the producer
+
+      /* Add an attack. Producer only.
+       *
+       * return: Whether there was room for it.
+       */
+      bool push(const Attack& attack);
+
+      /* Get the oldest attack without removing it, or null if the queue is empty.
+       * Consumer only.
+       */
+      const Attack* front() const;
+
+      /* Remove the oldest attack. Consumer only; the queue must not be empty. */
+      void pop();
+    };
+
+    /* What one board's thread shares with the other's. */
+    struct Board
+    {
+      GarbageQueue incoming;
+      alignas(64) std::atomic<long> frame{0}; // Frames completed; attacks sent before each are queued
+      std::atomic<bool> done{false};          // Set once frame is final
+    };
+
+    /* Settings for versus matches */
+    struct MatchSettings
+    {
+      session::GameSettings game_settings;
+      long max_tetriminoes; // Each board stops after this many tetriminoes lock (0 for no limit)
+    };
+
+    /* Statistics from one board of a finished match */
+    struct BoardStats
+    {
+      long score;
+      short rows;
+      long tetriminoes;
+      long frames;
+      bool topped_out;
+      long garbage_sent;     // Rows sent after cancelling incoming garbage
+      long garbage_received; // Rows added to the playfield
+      double seconds;        // Time the board's thread ran
+      double wait_seconds;   // Part of that spent waiting for the other board
+      batch::SearchCounters search;
+    };
+
+    /* Statistics from one finished match */
+    struct MatchStats
+    {
+      std::array<BoardStats, 2> boards;
+      short winner; // Index of the winning board, or -1 for a draw
+      double seconds;
+    };
+
+    /* Settings for a batch of matches */
+    struct VersusSettings
+    {
+      MatchSettings match_settings;
+      long matches;
+      unsigned threads;
+      std::uint64_t seed;
+    };
+
+    /* Results of a batch of matches */
+    struct VersusResult
+    {
+      std::vector<MatchStats> matches;
+      unsigned threads;
+      double seconds;
+    };
+
+    /* Play one board of a match on the calling thread.
+     *
+     * Attacks are stamped with the frame they are sent in and arrive GARBAGE_DELAY frames
+     * later. Before each frame the board waits, spinning, until the opponent has finished
+     * every frame whose garbage could arrive by then, so a board never runs more than
+     * GARBAGE_DELAY frames ahead and results do not depend on thread timing. Garbage that
+     * has arrived is cancelled by the board's own attacks, and otherwise added as soon as
+     * a tetrimino locks without clearing a row.
+     *
+     * A board stops when it tops out, reaches the tetrimino limit, or plays GARBAGE_DELAY
+     * frames past the end of the opponent, once any garbage still in flight has landed.
+     *
+     * settings[in]: Settings for the match.
+     * seed[in]: Seed for the board's bag and garbage holes.
+     * policy[in]: Policy choosing the board's commands.
+     * self[in,out]: This board's shared state.
+     * opponent[in,out]: The other board's shared state.
+     */
+    BoardStats play_board(const MatchSettings& settings,
+                          std::uint64_t seed,
+                          batch::Policy& policy,
+                          Board& self,
+                          Board& opponent);
+
+    /* Play a match between two policies, each board on its own thread.
+     *
+     * The second board runs on a new thread and the first on the calling thread. Both
+     * bags are dealt from the same seed, so both boards receive the same tetriminoes.
+     * The board that tops out later wins; it is a draw if neither tops out, or both do in
+     * the same frame.
+     */
+    MatchStats play_match(const MatchSettings& settings,
+                          std::uint64_t seed,
+                          batch::Policy& first,
+                          batch::Policy& second);
+
+    /* Play a batch of matches across a thread pool, headless.
+     *
+     * Each match takes two threads, so settings.threads / 2 matches run at once.
+     */
+    VersusResult run_matches(const VersusSettings& settings, const batch::PolicyFactory& make_policy);
+  }
+}
+
+#endif